@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include "compiler_engine.h"
 #include "tokenizer.h"
@@ -8,6 +9,25 @@
 /*****************************************************************************/
 /* PRIVATE FUNCTIONS */
 /*****************************************************************************/
+static inline void charge(compEng *eng, uint64_t instructions)
+{
+    if (eng->cost != NULL) {
+        cost_charge(eng->cost, instructions);
+    }
+}
+
+// Remembers a class named in the file, for its depfile. Qualifiers of
+// calls may also be variables, those never match a class file and are
+// dropped when the depfile is written
+static inline void record_class_ref(compEng *eng, const Token* tok)
+{
+    if (eng->deps != NULL
+            && dep_addClass(eng->deps, &eng->tknzr->content[tok->start], tok->end - tok->start) < 0)
+    {
+        compEng_reportError(eng, tok->start, "Error: Could not record dependency");
+    }
+}
+
 int consume_token_helper(compEng *eng, bool condition, TokenType tokType)
 {
     Tokenizer *t = eng->tknzr;
@@ -92,13 +112,224 @@ bool is_statement_keyword(Keyword kw)
     return false;
 }
 
+// Panic mode error recovery: skips tokens until a synchronization point.
+// A ';' ends the broken construct and is consumed, '}' and the keywords in
+// 'kws' start the next construct and are left for the caller. A block
+// opened within the skipped tokens is skipped as a whole, so its '}' isn't
+// taken for the end of the enclosing one. With 'onSymbols' false only
+// keywords synchronize and braces are not counted
+void synchronize(compEng *eng, const Keyword *kws, uint8_t kwsCount, bool onSymbols)
+{
+    Tokenizer *t = eng->tknzr;
+    uint32_t depth = 0;
+
+    while (tknzr_has_more_tokens(t)) {
+        if (onSymbols && t->currTok.type == TOK_TYPE_SYMBOL) {
+            char c = t->content[t->currTok.start];
+
+            if (c == '{') {
+                depth++;
+            }
+            else if (c == '}' && depth > 0) {
+                depth--;
+            }
+            else if (depth == 0 && c == ';') {
+                tknzr_advance(t);
+                return;
+            }
+            else if (depth == 0 && c == '}') {
+                return;
+            }
+        }
+        else if (depth == 0 && t->currTok.type == TOK_TYPE_KEYWORD) {
+            for (uint8_t i = 0; i < kwsCount; i++) {
+                if (t->currTok.keyword == kws[i]) {
+                    return;
+                }
+            }
+        }
+
+        tknzr_advance(t);
+    }
+}
+
+// Records a syntax error at the current token and restores the output
+// indentation of the construct that failed half way
+void recover_from_error(compEng *eng, uint8_t recurseLevel)
+{
+    compEng_reportError(eng, eng->tknzr->currTok.start,
+                        "Parse Error: Did not get expected token");
+    eng->recurseLevel = recurseLevel;
+}
+
+// Recovery has to move past the token where the failed construct started.
+// On truncated input the last token is never consumed, so retrying the
+// construct would loop forever
+bool recovery_stuck(compEng *eng, uint64_t constructStart)
+{
+    Tokenizer *t = eng->tknzr;
+
+    return !tknzr_has_more_tokens(t) || t->currTok.start == constructStart;
+}
+
+// Rule:
+// statement*
+int compile_statements(compEng *eng)
+{
+    Tokenizer *t = eng->tknzr;
+    const Keyword syncKeywords[] = {
+        KW_LET, KW_DO, KW_IF, KW_WHILE, KW_RETURN
+    };
+
+    while (is_statement_keyword(t->currTok.keyword)) {
+        uint8_t  recurseLevel = eng->recurseLevel;
+        uint8_t  loopDepth = eng->cost ? eng->cost->loopDepth : 0;
+        uint64_t start = t->currTok.start;
+        bool     stuck = false;
+
+        if (eng->cost != NULL) {
+            cost_beginStatement(eng->cost, t->currTok.start, t->currTok.keyword);
+        }
+
+        if (compEng_compileStatement(eng) < 0) {
+            recover_from_error(eng, recurseLevel);
+            synchronize(eng, syncKeywords, ARR_SIZE(syncKeywords), true);
+            if (eng->cost != NULL) {
+                eng->cost->loopDepth = loopDepth;
+            }
+            stuck = recovery_stuck(eng, start);
+        }
+
+        if (eng->cost != NULL) {
+            cost_endStatement(eng->cost);
+        }
+
+        if (stuck) {
+            return -EINVAL;
+        }
+    }
+
+    return 0;
+}
+
+// Subroutines are found in the same order by the signature scan, so the
+// position within the class identifies the index entry
+bool is_unreachable_subroutine(compEng *eng)
+{
+    const ClassSig* cls = eng->classSig;
+
+    if (cls == NULL || !eng->index->hasReachability
+            || eng->subroutineIdx >= cls->subroutinesCount) {
+        return false;
+    }
+
+    return !cls->subroutines[eng->subroutineIdx].reachable;
+}
+
+// Looks the callee up in the program index, then in the library signature
+// file. 'classTok' is NULL for calls without a class or variable qualifier
+ResolvedCall resolve_call(compEng *eng, Token* classTok, const char* subName, uint16_t subLen)
+{
+    Tokenizer*      t = eng->tknzr;
+    ResolvedCall    call = { .classKnown = false, .found = false };
+    const ClassSig* cls = eng->classSig;
+
+    if (classTok != NULL) {
+        const char* className = &t->content[classTok->start];
+        uint16_t    classLen = classTok->end - classTok->start;
+
+        cls = progIdx_findClass(eng->index, className, classLen);
+        if (cls == NULL) {
+            const SigFileClass* libCls = sigFile_findClass(eng->library, className, classLen);
+            if (libCls != NULL) {
+                const SigFileSub* libSub = sigFile_findSubroutine(eng->library, libCls,
+                                                                  subName, subLen);
+                call.classKnown = true;
+                call.found = libSub != NULL;
+                if (call.found) {
+                    call.kind = sigFile_kindKeyword(libSub);
+                    call.nParams = libSub->nParams;
+                }
+            }
+            return call;
+        }
+    }
+
+    if (cls != NULL) {
+        const SubroutineSig* sub = progIdx_findSubroutine(cls, subName, subLen);
+        call.classKnown = true;
+        call.found = sub != NULL;
+        if (call.found) {
+            call.kind = sub->kind;
+            call.nParams = sub->nParams;
+        }
+    }
+
+    return call;
+}
+
+// Checks a call against the known signatures. Calls through variables and
+// to classes that are neither part of the compilation nor of the library
+// are not checked. Mismatches are reported as diagnostics, they don't stop
+// compilation
+int check_subroutine_call(compEng *eng, Token* classTok, Token* subTok, int nArgs)
+{
+    Tokenizer*   t = eng->tknzr;
+    const char*  subName = &t->content[subTok->start];
+    uint16_t     subLen = subTok->end - subTok->start;
+    const char*  className = eng->className;
+    int          classLen = strlen(eng->className);
+    ResolvedCall call = resolve_call(eng, classTok, subName, subLen);
+
+    if (!call.classKnown) {
+        return 0;
+    }
+
+    if (classTok != NULL) {
+        className = &t->content[classTok->start];
+        classLen = classTok->end - classTok->start;
+    }
+
+    if (!call.found) {
+        compEng_reportError(eng, subTok->start, "Error: Class %.*s has no subroutine %.*s",
+                            classLen, className, subLen, subName);
+        return 0;
+    }
+
+    if (classTok != NULL && call.kind == KW_METHOD) {
+        compEng_reportError(eng, subTok->start, "Error: Method %.*s.%.*s called without an object",
+                            classLen, className, subLen, subName);
+        return 0;
+    }
+
+    if (call.nParams != nArgs) {
+        compEng_reportError(eng, subTok->start, "Error: %.*s.%.*s expects %d arguments, got %d",
+                            classLen, className, subLen, subName, call.nParams, nArgs);
+        return 0;
+    }
+
+    return 0;
+}
+
 /*****************************************************************************/
 /* PUBLIC FUNCTIONS */
 /*****************************************************************************/
-int compEng_new(compEng *eng, Tokenizer *t)
+int compEng_new(compEng *eng, Tokenizer *t, FILE* out, const ProgramIndex* index)
 {
     eng->tknzr = t;
     eng->recurseLevel = 0;
+    eng->outputFile = out;
+    eng->index = index;
+    eng->classSig = NULL;
+    eng->className[0] = '\0';
+    eng->subroutineIdx = 0;
+    eng->suppressOutput = false;
+    eng->droppedSubroutines = 0;
+    eng->droppedBytes = 0;
+    eng->cost = NULL;
+    eng->library = NULL;
+    eng->deps = NULL;
+    eng->diagsCount = 0;
     return 0;
 }
 
@@ -106,12 +337,57 @@ void compEng_close(compEng *eng)
 {
 }
 
+// Records an error to be printed once compilation is done. Only the first
+// MAX_DIAGNOSTICS are kept
+void compEng_reportError(compEng *eng, uint64_t offset, const char* fmt, ...)
+{
+    va_list args;
+
+    if (eng->diagsCount < MAX_DIAGNOSTICS) {
+        Diagnostic* d = &eng->diags[eng->diagsCount];
+        d->offset = offset;
+
+        va_start(args, fmt);
+        vsnprintf(d->msg, sizeof(d->msg), fmt, args);
+        va_end(args);
+
+        // A construct that fails at the end of the input is reported by
+        // every enclosing level, keep only the first report
+        if (eng->diagsCount > 0 && d[-1].offset == offset && strcmp(d[-1].msg, d->msg) == 0) {
+            return;
+        }
+    }
+
+    if (eng->diagsCount < UINT16_MAX) {
+        eng->diagsCount++;
+    }
+}
+
+// Prints all recorded diagnostics, returns how many errors there were
+int compEng_printDiagnostics(compEng *eng)
+{
+    uint16_t kept = eng->diagsCount < MAX_DIAGNOSTICS ? eng->diagsCount : MAX_DIAGNOSTICS;
+
+    for (uint16_t i = 0; i < kept; i++) {
+        LOG_ERR_AT(eng->tknzr, eng->diags[i].offset, "%s", eng->diags[i].msg);
+    }
+
+    if (eng->diagsCount > kept) {
+        LOG_ERR("%s: %d more errors not shown", eng->tknzr->path, eng->diagsCount - kept);
+    }
+
+    return eng->diagsCount;
+}
+
 // Rule:
 // 'class' className '{' classVarDec* subroutineDec* '}'
 int compEng_compileClass(compEng *eng)
 {
     int ret;
     Tokenizer* t = eng->tknzr;
+    const Keyword syncKeywords[] = {
+        KW_STATIC, KW_FIELD, KW_CONSTRUCTOR, KW_FUNCTION, KW_METHOD
+    };
 
     // Open tag ...........................................
     eng->recurseLevel++;
@@ -123,19 +399,80 @@ int compEng_compileClass(compEng *eng)
     
     EXIT_ON_ERR(consume_identifier(eng));
     write_identifier(eng, &eng->tknzr->prevTok);
+    tknzr_get_token_str(t, &t->prevTok, eng->className, sizeof(eng->className));
+    eng->classSig = progIdx_findClass(eng->index, eng->className, strlen(eng->className));
+    // Another file declaring a class of the same name isn't this class
+    if (eng->classSig != NULL && strcmp(eng->classSig->path, t->path) != 0) {
+        eng->classSig = NULL;
+    }
 
     EXIT_ON_ERR(consume_symbol(eng, '{'));
     write_symbol(eng, '{');
 
     while (t->currTok.keyword == KW_STATIC || t->currTok.keyword == KW_FIELD) {
-        EXIT_ON_ERR(compEng_compileClassVarDec(eng));
+        uint8_t  recurseLevel = eng->recurseLevel;
+        uint64_t start = t->currTok.start;
+
+        if (compEng_compileClassVarDec(eng) < 0) {
+            recover_from_error(eng, recurseLevel);
+            synchronize(eng, syncKeywords, ARR_SIZE(syncKeywords), true);
+            if (recovery_stuck(eng, start)) {
+                return -EINVAL;
+            }
+        }
     }
 
-    while (t->currTok.keyword == KW_FUNCTION
-            || t->currTok.keyword == KW_METHOD
-            || t->currTok.keyword == KW_CONSTRUCTOR)
-    {
-        EXIT_ON_ERR(compEng_compileSubroutineDec(eng));
+    while (true) {
+        while (t->currTok.keyword == KW_FUNCTION
+                || t->currTok.keyword == KW_METHOD
+                || t->currTok.keyword == KW_CONSTRUCTOR)
+        {
+            uint8_t  recurseLevel = eng->recurseLevel;
+            bool     dropped = is_unreachable_subroutine(eng);
+            uint64_t start = t->currTok.start;
+            bool     stuck = false;
+
+            if (eng->cost != NULL) {
+                cost_beginSubroutine(eng->cost, t->currTok.start);
+            }
+
+            // Unreachable subroutines are still compiled for their diagnostics
+            eng->suppressOutput = dropped;
+            if (compEng_compileSubroutineDec(eng) < 0) {
+                // Braces inside a broken subroutine can't be trusted, resume
+                // at the next subroutine declaration
+                recover_from_error(eng, recurseLevel);
+                synchronize(eng, &syncKeywords[2], ARR_SIZE(syncKeywords) - 2, false);
+                stuck = recovery_stuck(eng, start);
+            }
+            eng->suppressOutput = false;
+
+            if (eng->cost != NULL) {
+                cost_endSubroutine(eng->cost, !dropped);
+            }
+
+            eng->droppedSubroutines += dropped;
+            eng->subroutineIdx++;
+
+            if (stuck) {
+                return -EINVAL;
+            }
+        }
+
+        // Anything else before the class' '}' is left over from a broken
+        // subroutine, resume at the next subroutine declaration
+        if (!tknzr_has_more_tokens(t)
+                || (t->currTok.type == TOK_TYPE_SYMBOL && t->content[t->currTok.start] == '}'))
+        {
+            break;
+        }
+
+        uint64_t start = t->currTok.start;
+        recover_from_error(eng, eng->recurseLevel);
+        synchronize(eng, &syncKeywords[2], ARR_SIZE(syncKeywords) - 2, false);
+        if (recovery_stuck(eng, start)) {
+            return -EINVAL;
+        }
     }
 
     EXIT_ON_ERR(consume_symbol(eng, '}'));
@@ -224,6 +561,12 @@ int compEng_compileSubroutineDec(compEng* eng)
     EXIT_ON_ERR(consume_identifier(eng));
     write_identifier(eng, &t->prevTok);
 
+    if (eng->cost != NULL) {
+        char name[MAX_IDENTIFIER_STR_LEN + 1] = "";
+        tknzr_get_token_str(t, &t->prevTok, name, sizeof(name));
+        cost_nameSubroutine(eng->cost, eng->className, name);
+    }
+
     EXIT_ON_ERR(consume_symbol(eng, '('));
     write_symbol(eng, '(');
 
@@ -258,6 +601,7 @@ int compEng_compileType(compEng* eng)
 
     EXIT_ON_ERR(consume_identifier(eng));
     write_identifier(eng, &t->prevTok);
+    record_class_ref(eng, &t->prevTok);
 
     return 0;
 }
@@ -274,13 +618,15 @@ int compEng_compileParameterList(compEng* eng)
     write_output(eng, "<parameterList>\n");
 
     // Compile according to rule ..........................
-    EXIT_ON_ERR(compEng_compileTypeVarName(eng));
+    if (t->content[t->currTok.start] != ')') {
+        EXIT_ON_ERR(compEng_compileTypeVarName(eng));
 
-    while (t->content[t->currTok.start] == ',') {
-        EXIT_ON_ERR(consume_symbol(eng, ','));
-        write_symbol(eng, ',');
+        while (t->content[t->currTok.start] == ',') {
+            EXIT_ON_ERR(consume_symbol(eng, ','));
+            write_symbol(eng, ',');
 
-        EXIT_ON_ERR(compEng_compileTypeVarName(eng));
+            EXIT_ON_ERR(compEng_compileTypeVarName(eng));
+        }
     }
 
     // Close tag ..........................................
@@ -310,9 +656,7 @@ int compEng_compileSubroutineBody(compEng* eng)
         EXIT_ON_ERR(compEng_compileVarDec(eng));
     }
 
-    while (is_statement_keyword(t->currTok.keyword)) {
-        EXIT_ON_ERR(compEng_compileStatement(eng));
-    }
+    EXIT_ON_ERR(compile_statements(eng));
 
     EXIT_ON_ERR(consume_symbol(eng, '}'));
     write_symbol(eng, '}');
@@ -328,6 +672,36 @@ int compEng_compileSubroutineBody(compEng* eng)
 // 'var' type varName (',' varName)* ';'
 int compEng_compileVarDec(compEng* eng)
 {
+    int        ret;
+    Tokenizer* t = eng->tknzr;
+
+    // Open tag ...........................................
+    eng->recurseLevel++;
+    write_output(eng, "<varDec>\n");
+
+    // Compile according to rule ..........................
+    EXIT_ON_ERR(consume_keyword(eng, KW_VAR));
+    write_keyword(eng, KW_VAR);
+
+    EXIT_ON_ERR(compEng_compileTypeVarName(eng));
+    charge(eng, COST_LOCAL_INIT);
+
+    while (t->content[t->currTok.start] == ',') {
+        EXIT_ON_ERR(consume_symbol(eng, ','));
+        write_symbol(eng, ',');
+
+        EXIT_ON_ERR(consume_identifier(eng));
+        write_identifier(eng, &t->prevTok);
+        charge(eng, COST_LOCAL_INIT);
+    }
+
+    EXIT_ON_ERR(consume_symbol(eng, ';'));
+    write_symbol(eng, ';');
+
+    // Close tag ..........................................
+    write_output(eng, "</varDec>\n");
+    eng->recurseLevel--;
+
     return 0;
 }
 
@@ -410,6 +784,10 @@ int compEng_compileLetStatement(compEng* eng)
 
         EXIT_ON_ERR(consume_symbol(eng, ']'));
         write_symbol(eng, ']');
+        charge(eng, COST_ARRAY_STORE);
+    }
+    else {
+        charge(eng, COST_POP);
     }
 
     EXIT_ON_ERR(consume_symbol(eng, '='));
@@ -434,6 +812,7 @@ int compEng_compileDoStatement(compEng* eng)
     write_keyword(eng, KW_DO);
 
     EXIT_ON_ERR(compEng_compileSubroutineCall(eng));
+    charge(eng, COST_POP); // Discard return value
 
     EXIT_ON_ERR(consume_symbol(eng, ';'));
     write_symbol(eng, ';');
@@ -451,6 +830,7 @@ int compEng_compileIfStatement(compEng* eng)
 
     EXIT_ON_ERR(consume_keyword(eng, KW_IF));
     write_keyword(eng, KW_IF);
+    charge(eng, COST_NOT + COST_IF_GOTO);
 
     EXIT_ON_ERR(consume_symbol(eng, '('));
     write_symbol(eng, '(');
@@ -463,20 +843,20 @@ int compEng_compileIfStatement(compEng* eng)
     EXIT_ON_ERR(consume_symbol(eng, '{'));
     write_symbol(eng, '{');
 
-    while (is_statement_keyword(t->currTok.keyword)) {
-        EXIT_ON_ERR(compEng_compileStatement(eng));
-    }
+    EXIT_ON_ERR(compile_statements(eng));
 
     EXIT_ON_ERR(consume_symbol(eng, '}'));
     write_symbol(eng, '}');
 
     if (t->currTok.keyword == KW_ELSE) {
+        EXIT_ON_ERR(consume_keyword(eng, KW_ELSE));
+        write_keyword(eng, KW_ELSE);
+        charge(eng, COST_GOTO);
+
         EXIT_ON_ERR(consume_symbol(eng, '{'));
         write_symbol(eng, '{');
 
-        while (is_statement_keyword(t->currTok.keyword)) {
-            EXIT_ON_ERR(compEng_compileStatement(eng));
-        }
+        EXIT_ON_ERR(compile_statements(eng));
 
         EXIT_ON_ERR(consume_symbol(eng, '}'));
         write_symbol(eng, '}');
@@ -495,6 +875,12 @@ int compEng_compileWhileStatement(compEng *eng)
     EXIT_ON_ERR(consume_keyword(eng, KW_WHILE));
     write_keyword(eng, KW_WHILE);
 
+    // Condition and body run once per iteration
+    if (eng->cost != NULL) {
+        eng->cost->loopDepth++;
+    }
+    charge(eng, COST_NOT + COST_IF_GOTO + COST_GOTO);
+
     EXIT_ON_ERR(consume_symbol(eng, '('));
     write_symbol(eng, '(');
 
@@ -506,13 +892,15 @@ int compEng_compileWhileStatement(compEng *eng)
     EXIT_ON_ERR(consume_symbol(eng, '{'));
     write_symbol(eng, '{');
 
-    while (is_statement_keyword(t->currTok.keyword)) {
-        EXIT_ON_ERR(compEng_compileStatement(eng));
-    }
+    EXIT_ON_ERR(compile_statements(eng));
 
     EXIT_ON_ERR(consume_symbol(eng, '}'));
     write_symbol(eng, '}');
 
+    if (eng->cost != NULL) {
+        eng->cost->loopDepth--;
+    }
+
     return 0;
 }
 
@@ -530,6 +918,10 @@ int compEng_compileReturnStatement(compEng* eng)
     if (!(t->content[t->currTok.start] == ';')) {
         EXIT_ON_ERR(compEng_compileExpression(eng));
     }
+    else {
+        charge(eng, COST_PUSH); // void subroutines return 0
+    }
+    charge(eng, COST_RETURN);
 
     EXIT_ON_ERR(consume_symbol(eng, ';'));
     write_symbol(eng, ';');
@@ -548,6 +940,7 @@ int compEng_compileExpression(compEng* eng)
 
     EXIT_ON_ERR(consume_identifier(eng));
     write_identifier(eng, &t->prevTok);
+    charge(eng, COST_PUSH);
 
     return 0;
 }
@@ -567,7 +960,11 @@ int compEng_compileTerm(compEng* eng)
 int compEng_compileSubroutineCall(compEng* eng)
 {
     int ret;
+    int nArgs;
     Tokenizer* t = eng->tknzr;
+    Token classTok;
+    Token subTok;
+    bool qualified = false;
 
     // Open tag ...........................................
     eng->recurseLevel++;
@@ -577,6 +974,7 @@ int compEng_compileSubroutineCall(compEng* eng)
 
     EXIT_ON_ERR(consume_identifier(eng));
     write_identifier(eng, &t->prevTok);
+    subTok = t->prevTok;
 
     if (t->content[t->currTok.start] == '.') {
         EXIT_ON_ERR(consume_symbol(eng, '.'));
@@ -584,16 +982,37 @@ int compEng_compileSubroutineCall(compEng* eng)
 
         EXIT_ON_ERR(consume_identifier(eng));
         write_identifier(eng, &t->prevTok);
+        classTok = subTok;
+        subTok = t->prevTok;
+        qualified = true;
+        record_class_ref(eng, &classTok);
     }
 
     EXIT_ON_ERR(consume_symbol(eng, '('));
     write_symbol(eng, '(');
 
     EXIT_ON_ERR(compEng_compileExpressionList(eng));
+    nArgs = ret;
 
     EXIT_ON_ERR(consume_symbol(eng, ')'));
     write_symbol(eng, ')');
 
+    EXIT_ON_ERR(check_subroutine_call(eng, qualified ? &classTok : NULL, &subTok, nArgs));
+
+    if (eng->cost != NULL) {
+        char fullName[COST_MAX_NAME_LEN];
+        if (qualified) {
+            snprintf(fullName, sizeof(fullName), "%.*s.%.*s",
+                     (int)(classTok.end - classTok.start), &t->content[classTok.start],
+                     (int)(subTok.end - subTok.start), &t->content[subTok.start]);
+        }
+        else {
+            snprintf(fullName, sizeof(fullName), "%s.%.*s", eng->className,
+                     (int)(subTok.end - subTok.start), &t->content[subTok.start]);
+        }
+        cost_chargeCall(eng->cost, fullName);
+    }
+
     // Close tag ...........................................
     write_output(eng, "</subroutineCall>\n");
     eng->recurseLevel--;
@@ -601,9 +1020,13 @@ int compEng_compileSubroutineCall(compEng* eng)
     return 0;
 }
 
+// Rule:
+// (expression (',' expression)*)?
+// Returns the number of expressions in the list
 int compEng_compileExpressionList(compEng* eng)
 {
     int ret;
+    int count = 0;
     Tokenizer* t = eng->tknzr;
 
     // Open tag ...........................................
@@ -611,10 +1034,22 @@ int compEng_compileExpressionList(compEng* eng)
     write_output(eng, "<expressionList>\n");
 
     // Compile according to rule ..........................
+    if (t->content[t->currTok.start] != ')') {
+        EXIT_ON_ERR(compEng_compileExpression(eng));
+        count++;
+
+        while (t->content[t->currTok.start] == ',') {
+            EXIT_ON_ERR(consume_symbol(eng, ','));
+            write_symbol(eng, ',');
+
+            EXIT_ON_ERR(compEng_compileExpression(eng));
+            count++;
+        }
+    }
 
     // Close tag ..........................................
-    write_output(eng, "<expressionList>\n");
+    write_output(eng, "</expressionList>\n");
     eng->recurseLevel--;
 
-    return 0;
+    return count;
 }
\ No newline at end of file
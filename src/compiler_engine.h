@@ -4,16 +4,52 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "tokenizer.h"
+#include "program_index.h"
+#include "cost_model.h"
+#include "signature_file.h"
+#include "depfile.h"
+
+#define MAX_DIAGNOSTICS     32
+#define MAX_DIAGNOSTIC_LEN  96
+
+typedef struct Diagnostic {
+    uint64_t offset;
+    char msg[MAX_DIAGNOSTIC_LEN];
+} Diagnostic;
+
+// Callee of a subroutine call as found in the known signatures
+typedef struct ResolvedCall {
+    bool    classKnown;
+    bool    found;
+    Keyword kind;
+    uint8_t nParams;
+} ResolvedCall;
 
 typedef struct compEng {
     FILE* outputFile;
     Tokenizer* tknzr;
     uint8_t recurseLevel;
+    const ProgramIndex* index;  // Signatures of all classes, may be NULL
+    const ClassSig* classSig;   // Entry of the class being compiled, may be NULL
+    char className[MAX_IDENTIFIER_STR_LEN + 1];
+    uint16_t subroutineIdx;     // Position of the current subroutineDec in class
+    bool suppressOutput;
+    uint16_t droppedSubroutines;
+    uint64_t droppedBytes;
+    CostReport* cost;           // Only set with --cost-report
+    const SignatureFile* library; // Precompiled library signatures, may be NULL
+    DepSet* deps;               // Only set with --depfile
+    Diagnostic diags[MAX_DIAGNOSTICS];
+    uint16_t diagsCount;        // Keeps counting past MAX_DIAGNOSTICS
 } compEng;
 
-int compEng_new(compEng* eng, Tokenizer* t);
+int compEng_new(compEng* eng, Tokenizer* t, FILE* out, const ProgramIndex* index);
 void compEng_close(compEng* eng);
 
+// Diagnostics
+void compEng_reportError(compEng* eng, uint64_t offset, const char* fmt, ...);
+int compEng_printDiagnostics(compEng* eng);
+
 // Program structure
 int compEng_compileClass(compEng* eng);
 int compEng_compileClassVarDec(compEng* eng);
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cost_model.h"
+#include "err_handler.h"
+#include "memory.h"
+
+typedef struct OsRoutineCost {
+    const char* name;
+    uint64_t    cost;
+} OsRoutineCost;
+
+/*****************************************************************************/
+/* PRIVATE VARIABLES */
+/*****************************************************************************/
+
+// Rough averages of the Hack instructions executed by a call to the
+// standard OS, including its return
+static const OsRoutineCost osRoutineCosts[] = {
+    { "Math.multiply",          400 },
+    { "Math.divide",            800 },
+    { "Math.sqrt",              2500 },
+    { "Math.abs",               20 },
+    { "Math.min",               30 },
+    { "Math.max",               30 },
+    { "String.new",             300 },
+    { "String.appendChar",      60 },
+    { "String.charAt",          40 },
+    { "String.length",          20 },
+    { "Memory.alloc",           250 },
+    { "Memory.deAlloc",         60 },
+    { "Memory.peek",            20 },
+    { "Memory.poke",            20 },
+    { "Array.new",              270 },
+    { "Array.dispose",          80 },
+    { "Output.printChar",       900 },
+    { "Output.printString",     9000 },
+    { "Output.printInt",        5000 },
+    { "Output.println",         100 },
+    { "Screen.drawPixel",       600 },
+    { "Screen.drawLine",        12000 },
+    { "Screen.drawRectangle",   40000 },
+    { "Screen.drawCircle",      60000 },
+    { "Screen.clearScreen",     80000 },
+    { "Keyboard.keyPressed",    20 },
+    { "Keyboard.readChar",      2000 },
+    { "Sys.wait",               5000 },
+};
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+static int append_entry(CostEntry** arr, uint32_t* count, uint32_t* cap, const CostEntry* e)
+{
+    if (*count == *cap) {
+        uint32_t newCap = *cap ? *cap * 2 : 64;
+        CostEntry* grown = mem_realloc(MEM_ENGINE, *arr, newCap * sizeof(CostEntry));
+        if (grown == NULL) {
+            return -ENOMEM;
+        }
+        *arr = grown;
+        *cap = newCap;
+    }
+
+    (*arr)[(*count)++] = *e;
+    return 0;
+}
+
+static int compare_cost_desc(const void* a, const void* b)
+{
+    const CostEntry* x = a;
+    const CostEntry* y = b;
+
+    return (x->cost < y->cost) - (x->cost > y->cost);
+}
+
+static void print_table(Tokenizer* t, const char* title, CostEntry* entries, uint32_t count)
+{
+    uint32_t line, col;
+
+    qsort(entries, count, sizeof(CostEntry), compare_cost_desc);
+
+    printf("%s\n", title);
+    for (uint32_t i = 0; i < count && i < COST_REPORT_ROWS; i++) {
+        tknzr_get_line_col(t, entries[i].offset, &line, &col);
+        printf("  %10lu  %-40s %s:%u:%u\n", (unsigned long)entries[i].cost,
+               entries[i].name, t->path, line, col);
+    }
+}
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+void cost_new(CostReport* r)
+{
+    memset(r, 0, sizeof(CostReport));
+}
+
+void cost_close(CostReport* r)
+{
+    mem_free(r->subroutines);
+    mem_free(r->statements);
+    r->subroutines = NULL;
+    r->statements = NULL;
+}
+
+void cost_beginSubroutine(CostReport* r, uint64_t offset)
+{
+    r->currSubroutine.offset = offset;
+    r->currSubroutine.cost = COST_FUNCTION;
+    r->currSubroutine.name[0] = '\0';
+    r->firstStatement = r->statementsCount;
+    r->openCount = 0;
+    r->loopDepth = 0;
+}
+
+void cost_nameSubroutine(CostReport* r, const char* className, const char* name)
+{
+    snprintf(r->currSubroutine.name, COST_MAX_NAME_LEN, "%s.%s", className, name);
+}
+
+void cost_endSubroutine(CostReport* r, bool keep)
+{
+    if (keep) {
+        append_entry(&r->subroutines, &r->subroutinesCount, &r->subroutinesCap,
+                     &r->currSubroutine);
+    }
+    else {
+        r->statementsCount = r->firstStatement;
+    }
+}
+
+void cost_beginStatement(CostReport* r, uint64_t offset, Keyword kw)
+{
+    if (r->openCount >= COST_MAX_STATEMENT_DEPTH) {
+        return;
+    }
+
+    CostEntry* e = &r->open[r->openCount++];
+    e->offset = offset;
+    e->cost = 0;
+    snprintf(e->name, sizeof(e->name), "%.*s %s", COST_MAX_NAME_LEN - 1,
+             r->currSubroutine.name, keywords[kw]);
+}
+
+void cost_endStatement(CostReport* r)
+{
+    if (r->openCount == 0) {
+        return;
+    }
+
+    r->openCount--;
+    append_entry(&r->statements, &r->statementsCount, &r->statementsCap,
+                 &r->open[r->openCount]);
+}
+
+void cost_charge(CostReport* r, uint64_t instructions)
+{
+    uint8_t depth = r->loopDepth < COST_MAX_LOOP_DEPTH ? r->loopDepth : COST_MAX_LOOP_DEPTH;
+
+    for (uint8_t i = 0; i < depth; i++) {
+        instructions *= COST_LOOP_WEIGHT;
+    }
+
+    r->currSubroutine.cost += instructions;
+    if (r->openCount > 0) {
+        r->open[r->openCount - 1].cost += instructions;
+    }
+}
+
+void cost_chargeCall(CostReport* r, const char* fullName)
+{
+    uint64_t cost = COST_CALL;
+
+    for (uint8_t i = 0; i < ARR_SIZE(osRoutineCosts); i++) {
+        if (strcmp(osRoutineCosts[i].name, fullName) == 0) {
+            cost += osRoutineCosts[i].cost;
+            break;
+        }
+    }
+
+    cost_charge(r, cost);
+}
+
+void cost_print(CostReport* r, Tokenizer* t)
+{
+    // One file's report shouldn't interleave with others compiled in parallel
+    flockfile(stdout);
+
+    printf("Cost report for %s (estimated Hack instructions, loops weighted x%d)\n",
+           t->path, COST_LOOP_WEIGHT);
+    print_table(t, "Subroutines:", r->subroutines, r->subroutinesCount);
+    print_table(t, "Statements:", r->statements, r->statementsCount);
+
+    funlockfile(stdout);
+}
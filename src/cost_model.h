@@ -0,0 +1,76 @@
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <stdint.h>
+#include "tokenizer.h"
+
+// Estimated Hack instructions for the VM code of each construct, based on
+// the textbook VM translator
+#define COST_PUSH               10
+#define COST_POP                13
+#define COST_ARITH              8
+#define COST_NOT                5
+#define COST_IF_GOTO            6
+#define COST_GOTO               2
+#define COST_CALL               50
+#define COST_RETURN             45
+#define COST_FUNCTION           5
+#define COST_LOCAL_INIT         7
+#define COST_ARRAY_STORE        (COST_PUSH + COST_ARITH + 3 * COST_POP + COST_PUSH)
+
+// Every enclosing while loop multiplies the cost of a statement
+#define COST_LOOP_WEIGHT        10
+#define COST_MAX_LOOP_DEPTH     6
+
+#define COST_MAX_STATEMENT_DEPTH 64
+#define COST_REPORT_ROWS        10
+#define COST_MAX_NAME_LEN       (2 * MAX_IDENTIFIER_STR_LEN + 2)
+
+// Subroutine name followed by the statement keyword
+#define COST_MAX_ENTRY_NAME_LEN (COST_MAX_NAME_LEN + MAX_KEYWORD_STR_LEN)
+
+typedef struct CostEntry {
+    uint64_t offset;
+    uint64_t cost;
+    char     name[COST_MAX_ENTRY_NAME_LEN];
+} CostEntry;
+
+// Static cost estimate of one file, filled while it is compiled
+typedef struct CostReport {
+    CostEntry* subroutines;
+    uint32_t   subroutinesCount;
+    uint32_t   subroutinesCap;
+    CostEntry* statements;
+    uint32_t   statementsCount;
+    uint32_t   statementsCap;
+
+    // Statements currently being compiled, innermost last
+    CostEntry  open[COST_MAX_STATEMENT_DEPTH];
+    uint8_t    openCount;
+    CostEntry  currSubroutine;
+    uint32_t   firstStatement;  // Statements of currSubroutine start here
+    uint8_t    loopDepth;
+} CostReport;
+
+void cost_new(CostReport* r);
+void cost_close(CostReport* r);
+
+void cost_beginSubroutine(CostReport* r, uint64_t offset);
+void cost_nameSubroutine(CostReport* r, const char* className, const char* name);
+// Without 'keep' the subroutine and its statements are left out of the report
+void cost_endSubroutine(CostReport* r, bool keep);
+
+void cost_beginStatement(CostReport* r, uint64_t offset, Keyword kw);
+void cost_endStatement(CostReport* r);
+
+// Adds 'instructions' weighted by the current loop nesting
+void cost_charge(CostReport* r, uint64_t instructions);
+
+// Charges a call to 'fullName' (Class.subroutine), including the body of
+// known OS routines
+void cost_chargeCall(CostReport* r, const char* fullName);
+
+// Prints the most expensive subroutines and statements
+void cost_print(CostReport* r, Tokenizer* t);
+
+#endif // COST_MODEL_H
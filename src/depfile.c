@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "depfile.h"
+#include "memory.h"
+#include "err_handler.h"
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+// Copy of 'path' with its extension, if any, replaced by 'ext'
+static char* replace_extension(const char* path, const char* ext)
+{
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    size_t baseLen = strlen(path);
+    char* out;
+
+    if (dot != NULL && (slash == NULL || dot > slash)) {
+        baseLen = dot - path;
+    }
+
+    out = mem_alloc(MEM_ENGINE, baseLen + strlen(ext) + 1);
+    if (out != NULL) {
+        memcpy(out, path, baseLen);
+        strcpy(&out[baseLen], ext);
+    }
+
+    return out;
+}
+
+// Path of <name>.jack in the directory of 'srcPath'
+static char* sibling_source(const char* srcPath, const char* name)
+{
+    const char* slash = strrchr(srcPath, '/');
+    size_t dirLen = slash ? (size_t)(slash - srcPath + 1) : 0;
+    size_t nameLen = strlen(name);
+    char* out = mem_alloc(MEM_ENGINE, dirLen + nameLen + sizeof(".jack"));
+
+    if (out != NULL) {
+        memcpy(out, srcPath, dirLen);
+        memcpy(&out[dirLen], name, nameLen);
+        strcpy(&out[dirLen + nameLen], ".jack");
+    }
+
+    return out;
+}
+
+// Make needs spaces, '#' and '$' escaped in file names
+static void write_escaped(FILE* f, const char* path)
+{
+    for (const char* c = path; *c != '\0'; c++) {
+        if (*c == ' ' || *c == '#') {
+            fputc('\\', f);
+        }
+        else if (*c == '$') {
+            fputc('$', f);
+        }
+        fputc(*c, f);
+    }
+}
+
+// File that class 'name' is taken from, returned in '*dep', or NULL if no
+// file of it is known
+static int resolve_class_dep(const char* name, const char* srcPath,
+                             const DepLookup* lookup, char** dep)
+{
+    uint16_t nameLen = strlen(name);
+    const ClassSig* cls = NULL;
+    char* source;
+    char* sig;
+
+    *dep = NULL;
+
+    if (lookup->index != NULL) {
+        cls = progIdx_findClass(lookup->index, name, nameLen);
+    }
+    if (cls == NULL && sigFile_findClass(lookup->library, name, nameLen) != NULL) {
+        *dep = mem_strdup(MEM_ENGINE, lookup->libraryPath);
+        return *dep != NULL ? 0 : -ENOMEM;
+    }
+
+    source = cls != NULL ? mem_strdup(MEM_ENGINE, cls->path) : sibling_source(srcPath, name);
+    if (source == NULL) {
+        return -ENOMEM;
+    }
+    if (cls == NULL && access(source, F_OK) != 0) {
+        mem_free(source);
+        return 0;
+    }
+
+    // Without a stamp, e.g. for a class outside the compilation that was
+    // never indexed, the source is the only safe dependency
+    sig = lookup->signatures ? replace_extension(source, DEP_SIG_EXTENSION) : NULL;
+    if (sig != NULL && access(sig, F_OK) == 0) {
+        mem_free(source);
+        *dep = sig;
+    }
+    else {
+        mem_free(sig);
+        *dep = source;
+    }
+
+    return 0;
+}
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+void dep_new(DepSet* d)
+{
+    d->names = NULL;
+    d->count = 0;
+    d->cap = 0;
+}
+
+void dep_close(DepSet* d)
+{
+    mem_free(d->names);
+    d->names = NULL;
+    d->count = 0;
+    d->cap = 0;
+}
+
+int dep_addClass(DepSet* d, const char* name, uint16_t nameLen)
+{
+    if (nameLen > MAX_IDENTIFIER_STR_LEN) {
+        return -EINVAL;
+    }
+
+    for (uint32_t i = 0; i < d->count; i++) {
+        if (strncmp(d->names[i], name, nameLen) == 0 && d->names[i][nameLen] == '\0') {
+            return 0;
+        }
+    }
+
+    if (d->count == d->cap) {
+        uint32_t newCap = d->cap ? d->cap * 2 : 16;
+        void* grown = mem_realloc(MEM_ENGINE, d->names, newCap * sizeof(*d->names));
+        if (grown == NULL) {
+            return -ENOMEM;
+        }
+        d->names = grown;
+        d->cap = newCap;
+    }
+
+    memcpy(d->names[d->count], name, nameLen);
+    d->names[d->count][nameLen] = '\0';
+    d->count++;
+
+    return 0;
+}
+
+int dep_write(const DepSet* d, const char* outPath, const char* srcPath,
+              const char* self, const DepLookup* lookup)
+{
+    int ret = 0;
+    char* depPath = replace_extension(outPath, DEP_FILE_EXTENSION);
+    char** deps;
+    uint32_t depsCount = 0;
+    FILE* f;
+
+    if (depPath == NULL) {
+        return -ENOMEM;
+    }
+
+    deps = mem_calloc(MEM_ENGINE, d->count, sizeof(char*));
+    if (deps == NULL && d->count > 0) {
+        mem_free(depPath);
+        return -ENOMEM;
+    }
+
+    for (uint32_t i = 0; i < d->count && ret == 0; i++) {
+        char* dep;
+        bool listed = false;
+
+        if (strcmp(d->names[i], self) == 0) {
+            continue;
+        }
+
+        ret = resolve_class_dep(d->names[i], srcPath, lookup, &dep);
+        for (uint32_t j = 0; j < depsCount && dep != NULL && !listed; j++) {
+            listed = strcmp(deps[j], dep) == 0;
+        }
+        if (dep != NULL && !listed) {
+            deps[depsCount++] = dep;
+        }
+        else {
+            mem_free(dep);
+        }
+    }
+
+    f = ret == 0 ? fopen(depPath, "w") : NULL;
+    if (ret == 0 && f == NULL) {
+        LOG_ERR("Could not open output file %s", depPath);
+        ret = -EACCES;
+    }
+
+    if (f != NULL) {
+        write_escaped(f, outPath);
+        fputs(": ", f);
+        write_escaped(f, srcPath);
+        for (uint32_t i = 0; i < depsCount; i++) {
+            fputs(" \\\n  ", f);
+            write_escaped(f, deps[i]);
+        }
+        fputc('\n', f);
+
+        // Like gcc -MP: an empty rule per dependency, so make doesn't fail
+        // once a class is removed or renamed
+        for (uint32_t i = 0; i < depsCount; i++) {
+            fputc('\n', f);
+            write_escaped(f, deps[i]);
+            fputs(":\n", f);
+        }
+
+        if (fclose(f) != 0) {
+            ret = -EIO;
+        }
+    }
+
+    for (uint32_t i = 0; i < depsCount; i++) {
+        mem_free(deps[i]);
+    }
+    mem_free(deps);
+    mem_free(depPath);
+
+    return ret;
+}
+
+int dep_writeSignatures(const ProgramIndex* idx)
+{
+    for (uint32_t i = 0; i < idx->classesCount; i++) {
+        int ret = dep_writeClassSignature(&idx->classes[i]);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+int dep_writeClassSignature(const ClassSig* cls)
+{
+    if (cls->name[0] == '\0') {
+        return 0;
+    }
+
+    char* sigPath = replace_extension(cls->path, DEP_SIG_EXTENSION);
+    if (sigPath == NULL) {
+        return -ENOMEM;
+    }
+
+    int ret = sigFile_writeClass(cls, sigPath);
+    mem_free(sigPath);
+    return ret;
+}
@@ -0,0 +1,51 @@
+#ifndef DEPFILE_H
+#define DEPFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tokenizer.h"
+#include "program_index.h"
+#include "signature_file.h"
+
+#define DEP_FILE_EXTENSION      ".d"
+#define DEP_SIG_EXTENSION       ".sig"
+
+// Names of the classes a file refers to, collected while it is compiled
+typedef struct DepSet {
+    char     (*names)[MAX_IDENTIFIER_STR_LEN + 1];
+    uint32_t count;
+    uint32_t cap;
+} DepSet;
+
+// Where the file of a referenced class is looked up: the classes of the
+// compilation, the library signature file and <Class>.jack next to the
+// source, in that order. Classes found nowhere (e.g. the Jack OS without
+// --index) are left out
+typedef struct DepLookup {
+    const ProgramIndex*  index;         // May be NULL
+    const SignatureFile* library;       // May be NULL
+    const char*          libraryPath;
+    bool                 signatures;    // Depend on <Class>.sig, not the source
+} DepLookup;
+
+void dep_new(DepSet* d);
+void dep_close(DepSet* d);
+
+// Adds a class name, names already in the set are ignored
+int dep_addClass(DepSet* d, const char* name, uint16_t nameLen);
+
+// Writes a Makefile style depfile next to 'outPath', with the extension
+// replaced by ".d": 'outPath' depends on 'srcPath' and on the file of every
+// class in 'd' other than 'self'. Every dependency also gets an empty rule,
+// like with gcc -MP
+int dep_write(const DepSet* d, const char* outPath, const char* srcPath,
+              const char* self, const DepLookup* lookup);
+
+// Writes <Class>.sig next to the source of every class in 'idx'. A stamp
+// is only rewritten when the signatures of its class change
+int dep_writeSignatures(const ProgramIndex* idx);
+
+// Same for a single class, e.g. one that was just scanned again
+int dep_writeClassSignature(const ClassSig* cls);
+
+#endif // DEPFILE_H
@@ -2,6 +2,13 @@
 
 #define LOG_ERR(...)    {printf(__VA_ARGS__); printf("\n");}
 
+// Like LOG_ERR, prefixed with the file:line:col of 'offset' in tokenizer 't'
+#define LOG_ERR_AT(t, offset, fmt, ...) { \
+    uint32_t line_, col_; \
+    tknzr_get_line_col((t), (offset), &line_, &col_); \
+    printf("%s:%u:%u: " fmt "\n", (t)->path, line_, col_, ##__VA_ARGS__); \
+}
+
 #define ARR_SIZE(a)     (sizeof(a)/sizeof(a[0]))
 
 #define EXIT_ON_ERR(exp) {ret = exp; if (ret < 0) return ret;}
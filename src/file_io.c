@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "file_io.h"
+#include "err_handler.h"
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+int fileio_read(const char* path, char** buf, uint64_t* cap, uint64_t* len, MemSubsystem sub)
+{
+    struct stat st;
+    uint64_t fileSize;
+    uint64_t done = 0;
+    int ret = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERR("No such file %s", path);
+        return -ENOENT;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        ret = -errno;
+        close(fd);
+        return ret;
+    }
+    fileSize = st.st_size;
+
+    // Allocate buffer to hold entire file contents
+    if (*buf == NULL || *cap < fileSize + 1) {
+        char* grown = mem_realloc(sub, *buf, fileSize + 1);
+        if (grown == NULL) {
+            close(fd);
+            LOG_ERR("Failed allocating memory\n");
+            return -ENOMEM;
+        }
+        *buf = grown;
+        *cap = fileSize + 1;
+    }
+
+    while (done < fileSize) {
+        ssize_t n = read(fd, *buf + done, fileSize - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            ret = -errno;
+            LOG_ERR("Failed reading %s", path);
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    close(fd);
+
+    (*buf)[done] = '\0';
+    *len = done;
+
+    return ret;
+}
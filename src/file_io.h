@@ -0,0 +1,12 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <stdint.h>
+#include "memory.h"
+
+// Reads the whole file at 'path' into '*buf' with a single open, fstat and
+// read. The buffer is only grown when the file doesn't fit, its content is
+// NUL terminated
+int fileio_read(const char* path, char** buf, uint64_t* cap, uint64_t* len, MemSubsystem sub);
+
+#endif // FILE_IO_H
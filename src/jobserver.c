@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "jobserver.h"
+#include "err_handler.h"
+
+#define MAX_HELD_TOKENS     64
+
+/*****************************************************************************/
+/* PRIVATE VARIABLES */
+/*****************************************************************************/
+static int  readFd = -1;
+static int  writeFd = -1;
+static bool underMake = false;
+
+// Tokens must be given back with the same value they were read with
+static char            heldTokens[MAX_HELD_TOKENS];
+static int             heldCount = 0;
+static pthread_mutex_t heldLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+static bool fd_is_valid(int fd)
+{
+    return fd >= 0 && fcntl(fd, F_GETFD) >= 0;
+}
+
+// Opens our own non-blocking read end. O_NONBLOCK can't be set on the
+// inherited descriptor itself as its flags are shared with make and all
+// other jobs
+static int open_nonblocking(const char* path)
+{
+    return open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+}
+
+static bool connect_fds(int r, int w)
+{
+    char path[64];
+
+    if (!fd_is_valid(r) || !fd_is_valid(w)) {
+        // make didn't pass the pipe to us, e.g. the rule isn't marked '+'
+        return false;
+    }
+
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", r);
+    readFd = open_nonblocking(path);
+    writeFd = w;
+
+    return readFd >= 0;
+}
+
+static bool connect_fifo(const char* path)
+{
+    readFd = open_nonblocking(path);
+    writeFd = open(path, O_WRONLY | O_CLOEXEC);
+
+    return readFd >= 0 && writeFd >= 0;
+}
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+bool jobserver_init(void)
+{
+    const char* flags = getenv("MAKEFLAGS");
+    const char* auth;
+    const char* options[] = { "--jobserver-auth=", "--jobserver-fds=" };
+    int r, w;
+
+    if (flags == NULL) {
+        return false;
+    }
+    underMake = true;
+
+    // The last occurrence wins, recursive makes append theirs
+    for (unsigned i = 0; i < ARR_SIZE(options); i++) {
+        const char* found = NULL;
+        for (auth = strstr(flags, options[i]); auth != NULL; auth = strstr(auth + 1, options[i])) {
+            found = auth;
+        }
+        if (found == NULL) {
+            continue;
+        }
+
+        found += strlen(options[i]);
+        if (strncmp(found, "fifo:", 5) == 0) {
+            char path[4096];
+            size_t len = strcspn(found + 5, " ");
+            if (len >= sizeof(path)) {
+                return false;
+            }
+            memcpy(path, found + 5, len);
+            path[len] = '\0';
+            return connect_fifo(path);
+        }
+
+        if (sscanf(found, "%d,%d", &r, &w) == 2) {
+            return connect_fds(r, w);
+        }
+    }
+
+    return false;
+}
+
+bool jobserver_active(void)
+{
+    return readFd >= 0 && writeFd >= 0;
+}
+
+bool jobserver_serial_make(void)
+{
+    return underMake && !jobserver_active();
+}
+
+bool jobserver_try_acquire(void)
+{
+    char token;
+
+    if (!jobserver_active()) {
+        return false;
+    }
+
+    pthread_mutex_lock(&heldLock);
+    bool acquired = heldCount < MAX_HELD_TOKENS && read(readFd, &token, 1) == 1;
+    if (acquired) {
+        heldTokens[heldCount++] = token;
+    }
+    pthread_mutex_unlock(&heldLock);
+
+    return acquired;
+}
+
+void jobserver_release(void)
+{
+    pthread_mutex_lock(&heldLock);
+    if (heldCount > 0) {
+        char token = heldTokens[--heldCount];
+        while (write(writeFd, &token, 1) < 0 && errno == EINTR) {
+        }
+    }
+    pthread_mutex_unlock(&heldLock);
+}
@@ -0,0 +1,25 @@
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <stdbool.h>
+
+// Client side of the GNU make jobserver. The process implicitly owns one
+// job slot, every additional worker thread needs a token from make.
+
+// Connects to the jobserver announced in MAKEFLAGS, if any. Returns true
+// when tokens have to be used
+bool jobserver_init(void);
+
+bool jobserver_active(void);
+
+// True when running below make without a jobserver, make expects serial
+// execution then
+bool jobserver_serial_make(void);
+
+// Takes a token without blocking, returns false if none is available
+bool jobserver_try_acquire(void);
+
+// Returns a token previously taken with jobserver_try_acquire()
+void jobserver_release(void);
+
+#endif // JOBSERVER_H
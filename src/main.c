@@ -1,7 +1,45 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "tokenizer.h"
 #include "err_handler.h"
 #include "compiler_engine.h"
+#include "watcher.h"
+#include "program_index.h"
+#include "parallel.h"
+#include "jobserver.h"
+#include "signature_file.h"
+#include "memory.h"
+#include "depfile.h"
+
+#define OUTPUT_FILE_EXTENSION   ".xml"
+#define ENTRY_CLASS             "Main"
+#define ENTRY_SUBROUTINE        "main"
+#define OUTPUT_BUFFER_SIZE      (64 * 1024)
+
+typedef struct CompileCtx {
+    const char* const*  paths;
+    const ProgramIndex* index;
+} CompileCtx;
+
+static bool stripUnused = false;
+static bool costReport = false;
+static uint16_t jobsLimit = 0;  // -j, 0 if not given
+static SignatureFile library;
+static const char* libraryPath = NULL;
+static bool libraryLoaded = false;
+static bool depfile = false;
+static bool depSignatures = false;
+static bool memStats = false;
+
+// --watch keeps the index of the previous round to find out which classes
+// changed their signatures
+static ProgramIndex watchIndex;
+static char** watchPaths = NULL;
+static uint32_t watchPathsCount = 0;
 
 static const char* tokType_enum2str[TOK_TYPE_COUNT] = {
     "keyword", "symbol", "identifier", "int-const", "string-const"
@@ -10,42 +48,833 @@ static const char* tokType_enum2str[TOK_TYPE_COUNT] = {
 /*****************************************************************************/
 /* FUNCTION PROTOTYPES */
 /*****************************************************************************/
+int compile_watched(const char* dir, const char* const* names, uint16_t count);
+int compile_single_file(const char* path);
+int compile_directory(const char* dir);
+int compile_batch(const char* manifestPath);
+int emit_index(const char* inputPath, const char* indexPath);
+int compile_source(const char* path, FILE* out, const char* outPath, const ProgramIndex* index);
+int compile_tokens(Tokenizer* t, FILE* out, const char* outPath, const ProgramIndex* index);
 int processKeyword(Tokenizer* t, compEng* eng);
+int parse_memory_size(const char* s, uint64_t* bytes);
 
 /*****************************************************************************/
 /* ENTRY POINT */
 /*****************************************************************************/
 
 int main(int argc, char **argv)
+{
+    bool watch = false;
+    const char* inputPath = NULL;
+    const char* manifestPath = NULL;
+    const char* emitIndexPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--watch") == 0) {
+            watch = true;
+        }
+        else if (strcmp(argv[i], "--strip-unused") == 0) {
+            stripUnused = true;
+        }
+        else if (strcmp(argv[i], "--cost-report") == 0) {
+            costReport = true;
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            manifestPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            libraryPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--emit-index") == 0 && i + 1 < argc) {
+            emitIndexPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--depfile") == 0) {
+            depfile = true;
+        }
+        else if (strcmp(argv[i], "--depfile-signatures") == 0) {
+            depfile = true;
+            depSignatures = true;
+        }
+        else if (strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc) {
+            uint64_t bytes;
+            if (parse_memory_size(argv[++i], &bytes) < 0) {
+                LOG_ERR("Invalid --max-memory value %s, expected N[K|M|G] with N > 0", argv[i]);
+                return -EINVAL;
+            }
+            mem_setBudget(bytes);
+        }
+        else if (strcmp(argv[i], "--mem-stats") == 0) {
+            memStats = true;
+            atexit(mem_printStats);
+        }
+        else if (strncmp(argv[i], "-j", 2) == 0) {
+            const char* n = argv[i][2] != '\0' ? &argv[i][2] : (i + 1 < argc ? argv[++i] : "0");
+            jobsLimit = atoi(n) > 0 ? atoi(n) : 0;
+        }
+        else {
+            inputPath = argv[i];
+        }
+    }
+
+    jobserver_init();
+
+    if (libraryPath != NULL) {
+        int ret = sigFile_open(&library, libraryPath);
+        if (ret < 0) {
+            return ret;
+        }
+        libraryLoaded = true;
+    }
+
+    if (manifestPath != NULL) {
+        return compile_batch(manifestPath);
+    }
+
+    if (inputPath == NULL) {
+        LOG_ERR("Please provide input file or directory\n");
+        return -EINVAL;
+    }
+
+    if (emitIndexPath != NULL) {
+        return emit_index(inputPath, emitIndexPath);
+    }
+
+    if (watch) {
+        return watch_directory(inputPath, compile_watched);
+    }
+
+    struct stat st;
+    if (stat(inputPath, &st) == 0 && S_ISDIR(st.st_mode)) {
+        return compile_directory(inputPath);
+    }
+
+    return compile_single_file(inputPath);
+}
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+// Parses a byte count with an optional K, M or G suffix. Signs, unknown
+// suffixes, trailing characters, zero and values past 64 bits are rejected
+int parse_memory_size(const char* s, uint64_t* bytes)
+{
+    char* suffix;
+    uint8_t shift = 0;
+    unsigned long long value;
+
+    if (!isdigit((unsigned char)s[0])) {
+        return -EINVAL;
+    }
+
+    errno = 0;
+    value = strtoull(s, &suffix, 10);
+    if (errno == ERANGE || value == 0) {
+        return -EINVAL;
+    }
+
+    switch (*suffix) {
+        case 'G': case 'g': shift = 30; suffix++; break;
+        case 'M': case 'm': shift = 20; suffix++; break;
+        case 'K': case 'k': shift = 10; suffix++; break;
+        default: break;
+    }
+    if (*suffix != '\0' || value > (UINT64_MAX >> shift)) {
+        return -EINVAL;
+    }
+
+    *bytes = (uint64_t)value << shift;
+    return 0;
+}
+
+// Upper bound of worker threads. With a jobserver the actual number also
+// depends on the tokens make hands out
+static uint16_t worker_count(void)
+{
+    if (jobsLimit > 0) {
+        return jobsLimit;
+    }
+    if (jobserver_active()) {
+        return PARALLEL_MAX_WORKERS;
+    }
+    if (jobserver_serial_make()) {
+        return 1;
+    }
+
+    return parallel_default_workers();
+}
+
+// First pass, collects signatures and with --strip-unused the call graph
+static int build_index(ProgramIndex* index, const char* const* paths, uint32_t count, uint16_t workers)
+{
+    int ret;
+
+    ret = progIdx_build(index, paths, count, workers, stripUnused);
+    if (ret == 0 && stripUnused) {
+        // Without an entry point nothing is dropped
+        progIdx_markReachable(index, ENTRY_CLASS, ENTRY_SUBROUTINE);
+    }
+    if (ret == 0 && depSignatures) {
+        ret = dep_writeSignatures(index);
+    }
+
+    return ret;
+}
+
+int compile_single_file(const char* path)
+{
+    int ret;
+    ProgramIndex index;
+
+    ret = build_index(&index, &path, 1, 1);
+    if (ret == 0) {
+        ret = compile_source(path, stdout, NULL, &index);
+    }
+
+    progIdx_free(&index);
+    return ret;
+}
+
+static bool has_jack_extension(const char* name)
+{
+    size_t len = strlen(name);
+    return len > 5 && strcmp(&name[len - 5], ".jack") == 0;
+}
+
+static int compare_paths(const void* a, const void* b)
+{
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Collects the paths of all '.jack' files in 'dir', sorted by name
+static int collect_sources(const char* dir, char*** paths, uint32_t* count)
+{
+    DIR* d = opendir(dir);
+    struct dirent* entry;
+    uint32_t cap = 0;
+
+    *paths = NULL;
+    *count = 0;
+
+    if (d == NULL) {
+        LOG_ERR("No such directory %s", dir);
+        return -ENOENT;
+    }
+
+    while ((entry = readdir(d)) != NULL) {
+        if (!has_jack_extension(entry->d_name)) {
+            continue;
+        }
+
+        if (*count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char** grown = mem_realloc(MEM_DRIVER, *paths, cap * sizeof(char*));
+            if (grown == NULL) {
+                closedir(d);
+                return -ENOMEM;
+            }
+            *paths = grown;
+        }
+
+        size_t len = strlen(dir) + strlen(entry->d_name) + 2;
+        char* path = mem_alloc(MEM_DRIVER, len);
+        if (path == NULL) {
+            closedir(d);
+            return -ENOMEM;
+        }
+        snprintf(path, len, "%s/%s", dir, entry->d_name);
+        (*paths)[(*count)++] = path;
+    }
+    closedir(d);
+
+    qsort(*paths, *count, sizeof(char*), compare_paths);
+    return 0;
+}
+
+// Returns <name>.xml for <name>.jack, to be freed by the caller
+static char* make_output_path(const char* path)
+{
+    size_t baseLen = strlen(path);
+    char* outPath;
+
+    if (has_jack_extension(path)) {
+        baseLen -= strlen(".jack");
+    }
+
+    outPath = mem_alloc(MEM_DRIVER, baseLen + sizeof(OUTPUT_FILE_EXTENSION));
+    if (outPath != NULL) {
+        memcpy(outPath, path, baseLen);
+        strcpy(&outPath[baseLen], OUTPUT_FILE_EXTENSION);
+    }
+
+    return outPath;
+}
+
+// Second pass job: compiles the bodies of one file into <name>.xml
+static int compile_job(void* ctx, uint32_t i)
+{
+    char outBuf[OUTPUT_BUFFER_SIZE];
+    int ret;
+    CompileCtx* c = ctx;
+    const char* path = c->paths[i];
+    char* outPath = make_output_path(path);
+    FILE* out;
+
+    if (outPath == NULL) {
+        return -ENOMEM;
+    }
+
+    out = fopen(outPath, "w");
+    if (out == NULL) {
+        LOG_ERR("Could not open output file %s", outPath);
+        mem_free(outPath);
+        return -EACCES;
+    }
+
+    // One write per output instead of one per stdio block
+    setvbuf(out, outBuf, _IOFBF, sizeof(outBuf));
+    ret = compile_source(path, out, outPath, c->index);
+    if (ret < 0) {
+        LOG_ERR("Failed compiling %s", path);
+    }
+
+    fclose(out);
+    mem_free(outPath);
+    return ret;
+}
+
+// Whole-program compilation: a first parallel pass collects the signatures
+// of all classes, a second one compiles every file against them
+int compile_directory(const char* dir)
+{
+    int ret;
+    char** paths;
+    uint32_t count;
+    uint16_t workers = worker_count();
+    ProgramIndex index;
+
+    ret = collect_sources(dir, &paths, &count);
+    if (ret == 0) {
+        ret = build_index(&index, (const char* const*)paths, count, workers);
+        if (ret == 0) {
+            CompileCtx ctx = { .paths = (const char* const*)paths, .index = &index };
+            ret = parallel_for(count, workers, compile_job, &ctx);
+        }
+        progIdx_free(&index);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        mem_free(paths[i]);
+    }
+    mem_free(paths);
+
+    return ret;
+}
+
+static const char* base_name(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static const ClassSig* find_class_by_file(const ProgramIndex* idx, const char* name)
+{
+    for (uint32_t i = 0; i < idx->classesCount; i++) {
+        if (strcmp(base_name(idx->classes[i].path), name) == 0) {
+            return &idx->classes[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Same interface: everything other files are checked against
+static bool same_signature(const ClassSig* a, const ClassSig* b)
+{
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+    if (strcmp(a->name, b->name) != 0 || a->nStatics != b->nStatics
+            || a->nFields != b->nFields || a->subroutinesCount != b->subroutinesCount) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < a->subroutinesCount; i++) {
+        const SubroutineSig* x = &a->subroutines[i];
+        const SubroutineSig* y = &b->subroutines[i];
+        if (strcmp(x->name, y->name) != 0 || x->kind != y->kind || x->nParams != y->nParams) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Compares against the flags a class had before the index was marked again
+static bool reachability_changed(const ClassSig* cls, const bool* before)
+{
+    for (uint16_t i = 0; i < cls->subroutinesCount; i++) {
+        if (cls->subroutines[i].reachable != before[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool calls_any_class(const ClassSig* cls, const char* const* classNames, uint32_t count)
+{
+    for (uint16_t i = 0; i < cls->subroutinesCount; i++) {
+        const SubroutineSig* sub = &cls->subroutines[i];
+        for (uint16_t j = 0; j < sub->callsCount; j++) {
+            for (uint32_t k = 0; k < count; k++) {
+                if (strcmp(sub->calls[j].qualifier, classNames[k]) == 0) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+// Saves the reachable flag of every subroutine, class by class
+static bool* save_reachability(const ProgramIndex* idx)
+{
+    uint32_t total = 0;
+    bool* flags;
+
+    for (uint32_t i = 0; i < idx->classesCount; i++) {
+        total += idx->classes[i].subroutinesCount;
+    }
+
+    flags = mem_alloc(MEM_DRIVER, total * sizeof(bool));
+    if (flags != NULL) {
+        total = 0;
+        for (uint32_t i = 0; i < idx->classesCount; i++) {
+            for (uint16_t j = 0; j < idx->classes[i].subroutinesCount; j++) {
+                flags[total++] = idx->classes[i].subroutines[j].reachable;
+            }
+        }
+    }
+
+    return flags;
+}
+
+static int watch_job(void* ctx, uint32_t i)
+{
+    CompileCtx* c = ctx;
+    int ret = compile_job(ctx, i);
+
+    printf("[watch] %s: %s\n", base_name(c->paths[i]), ret < 0 ? "failed" : "ok");
+    return ret;
+}
+
+static void free_paths(char** paths, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        mem_free(paths[i]);
+    }
+    mem_free(paths);
+}
+
+// One --watch round: scans the changed files again and takes the other
+// classes over from the previous round's index, then compiles the changed
+// files and every class calling into a class whose signature changed, like
+// a directory compile would
+int compile_watched(const char* dir, const char* const* names, uint16_t count)
+{
+    int ret;
+    char** paths;
+    uint32_t pathsCount;
+    ProgramIndex index = { 0 };
+    bool* rescan;
+    bool* wasReachable = NULL;
+    const char** sigChanged;    // Classes whose signature changed, old and new name
+    uint32_t sigChangedCount = 0;
+    const char** selected;
+    uint32_t selectedCount = 0;
+    uint32_t dependents = 0;
+    uint32_t offset = 0;
+
+    ret = collect_sources(dir, &paths, &pathsCount);
+    if (ret < 0) {
+        return ret;
+    }
+
+    rescan = mem_calloc(MEM_DRIVER, pathsCount, sizeof(bool));
+    selected = mem_calloc(MEM_DRIVER, pathsCount, sizeof(char*));
+    sigChanged = mem_calloc(MEM_DRIVER, 2 * count, sizeof(char*));
+    if (rescan == NULL || selected == NULL || sigChanged == NULL) {
+        ret = -ENOMEM;
+    }
+
+    for (uint32_t i = 0; i < pathsCount && ret == 0; i++) {
+        for (uint16_t j = 0; j < count && !rescan[i]; j++) {
+            rescan[i] = strcmp(base_name(paths[i]), names[j]) == 0;
+        }
+    }
+
+    if (ret == 0) {
+        ret = progIdx_update(&index, &watchIndex, (const char* const*)paths, pathsCount,
+                             rescan, worker_count(), true);
+    }
+
+    // The old signature of every changed file is looked up once, the
+    // classes below only check their calls against the collected names
+    for (uint16_t j = 0; j < count && ret == 0; j++) {
+        const ClassSig* before = find_class_by_file(&watchIndex, names[j]);
+        const ClassSig* after = find_class_by_file(&index, names[j]);
+
+        if (!same_signature(before, after)) {
+            if (before != NULL && before->name[0] != '\0') {
+                sigChanged[sigChangedCount++] = before->name;
+            }
+            if (after != NULL && after->name[0] != '\0') {
+                sigChanged[sigChangedCount++] = after->name;
+            }
+        }
+    }
+
+    if (ret == 0 && stripUnused) {
+        wasReachable = save_reachability(&index);
+        if (wasReachable == NULL) {
+            ret = -ENOMEM;
+        }
+        else {
+            progIdx_markReachable(&index, ENTRY_CLASS, ENTRY_SUBROUTINE);
+        }
+    }
+
+    for (uint32_t i = 0; i < pathsCount && ret == 0; i++) {
+        const ClassSig* cls = &index.classes[i];
+        bool dependent = !rescan[i] && calls_any_class(cls, sigChanged, sigChangedCount);
+
+        // Dropped subroutines change the output of classes nobody edited
+        if (stripUnused && !rescan[i] && reachability_changed(cls, &wasReachable[offset])) {
+            dependent = true;
+        }
+        offset += cls->subroutinesCount;
+
+        if (depSignatures && rescan[i]) {
+            ret = dep_writeClassSignature(cls);
+        }
+
+        if (rescan[i] || dependent) {
+            selected[selectedCount++] = cls->path;
+            dependents += dependent;
+        }
+    }
+
+    if (ret == 0) {
+        CompileCtx ctx = { .paths = selected, .index = &index };
+        if (dependents > 0) {
+            printf("[watch] recompiling %u dependent classes\n", dependents);
+        }
+        ret = parallel_for(selectedCount, worker_count(), watch_job, &ctx);
+    }
+    mem_free(rescan);
+    mem_free(wasReachable);
+    mem_free(sigChanged);
+    mem_free(selected);
+
+    // The new index becomes the reference for the next round. Classes may
+    // already have been moved out of the old one when the update failed, so
+    // then the next round starts over with a full scan
+    progIdx_free(&watchIndex);
+    free_paths(watchPaths, watchPathsCount);
+    if (ret == -ENOMEM) {
+        progIdx_free(&index);
+        free_paths(paths, pathsCount);
+        index = (ProgramIndex){ 0 };
+        paths = NULL;
+        pathsCount = 0;
+    }
+    watchIndex = index;
+    watchPaths = paths;
+    watchPathsCount = pathsCount;
+
+    return ret;
+}
+
+// Reads a manifest with one "source [output]" pair per line. Without an
+// output the source's <name>.xml is used
+static int read_manifest(const char* manifestPath, char*** srcs, char*** outs, uint32_t* count)
+{
+    FILE* f = stdin;
+    char* line = NULL;
+    size_t lineCap = 0;
+    uint32_t cap = 0;
+    int ret = 0;
+
+    *srcs = NULL;
+    *outs = NULL;
+    *count = 0;
+
+    if (strcmp(manifestPath, "-") != 0) {
+        f = fopen(manifestPath, "r");
+        if (f == NULL) {
+            LOG_ERR("No such file %s", manifestPath);
+            return -ENOENT;
+        }
+    }
+
+    while (getline(&line, &lineCap, f) >= 0) {
+        char* save;
+        char* src = strtok_r(line, " \t\r\n", &save);
+        char* out = strtok_r(NULL, " \t\r\n", &save);
+
+        if (src == NULL || src[0] == '#') {
+            continue;
+        }
+
+        if (*count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char** grownSrcs = mem_realloc(MEM_DRIVER, *srcs, cap * sizeof(char*));
+            char** grownOuts = mem_realloc(MEM_DRIVER, *outs, cap * sizeof(char*));
+            if (grownSrcs != NULL) {
+                *srcs = grownSrcs;
+            }
+            if (grownOuts != NULL) {
+                *outs = grownOuts;
+            }
+            if (grownSrcs == NULL || grownOuts == NULL) {
+                ret = -ENOMEM;
+                break;
+            }
+        }
+
+        char* srcCopy = mem_strdup(MEM_DRIVER, src);
+        char* outCopy = out ? mem_strdup(MEM_DRIVER, out) : make_output_path(src);
+        if (srcCopy == NULL || outCopy == NULL) {
+            mem_free(srcCopy);
+            mem_free(outCopy);
+            ret = -ENOMEM;
+            break;
+        }
+
+        (*srcs)[*count] = srcCopy;
+        (*outs)[*count] = outCopy;
+        (*count)++;
+    }
+
+    free(line);
+    if (f != stdin) {
+        fclose(f);
+    }
+
+    return ret;
+}
+
+static bool same_directory(const char* a, const char* b)
+{
+    const char* slashA = strrchr(a, '/');
+    const char* slashB = strrchr(b, '/');
+    size_t lenA = slashA ? (size_t)(slashA - a) : 0;
+    size_t lenB = slashB ? (size_t)(slashB - b) : 0;
+
+    return lenA == lenB && memcmp(a, b, lenA) == 0;
+}
+
+static int compile_batch_file(Tokenizer* t, const char* src, const char* outPath,
+                              const ProgramIndex* index, char* outBuf)
+{
+    int ret;
+
+    if (memStats) {
+        mem_fileBegin();
+        mem_fileHold(t->content);
+        mem_fileHold(t->lineStarts);
+    }
+
+    ret = tknzr_reset(t, src);
+    if (ret == 0) {
+        FILE* out = fopen(outPath, "w");
+        if (out == NULL) {
+            LOG_ERR("Could not open output file %s", outPath);
+            return -EACCES;
+        }
+
+        setvbuf(out, outBuf, _IOFBF, OUTPUT_BUFFER_SIZE);
+        ret = compile_tokens(t, out, outPath, index);
+        fclose(out);
+
+        if (memStats) {
+            mem_filePrint(src);
+        }
+    }
+
+    return ret;
+}
+
+// Compiles every file listed in a manifest ("-" for stdin) within this
+// process. Like a directory compile, the sources of each directory form a
+// program of their own and are checked against their own index. The
+// tokenizer and output buffers are shared by all files and only grown,
+// never freed in between. One status line is printed per file, grouped by
+// directory: "ok <source>" or "error <source>"
+int compile_batch(const char* manifestPath)
+{
+    static char outBuf[OUTPUT_BUFFER_SIZE];
+    int ret;
+    int failed = 0;
+    char** srcs;
+    char** outs;
+    uint32_t count;
+    uint32_t* group = NULL;
+    const char** groupSrcs = NULL;
+    bool* done = NULL;
+    Tokenizer tokenizer = { .content = NULL, .contentCap = 0, .lineStarts = NULL };
+
+    ret = read_manifest(manifestPath, &srcs, &outs, &count);
+    if (ret == 0 && count > 0) {
+        group = mem_alloc(MEM_DRIVER, count * sizeof(uint32_t));
+        groupSrcs = mem_alloc(MEM_DRIVER, count * sizeof(char*));
+        done = mem_calloc(MEM_DRIVER, count, sizeof(bool));
+        if (group == NULL || groupSrcs == NULL || done == NULL) {
+            ret = -ENOMEM;
+        }
+    }
+
+    for (uint32_t first = 0; first < count && ret == 0; first++) {
+        ProgramIndex index;
+        uint32_t groupCount = 0;
+
+        if (done[first]) {
+            continue;
+        }
+
+        for (uint32_t i = first; i < count; i++) {
+            if (!done[i] && same_directory(srcs[first], srcs[i])) {
+                done[i] = true;
+                group[groupCount] = i;
+                groupSrcs[groupCount++] = srcs[i];
+            }
+        }
+
+        ret = build_index(&index, groupSrcs, groupCount, worker_count());
+        for (uint32_t g = 0; g < groupCount && ret == 0; g++) {
+            uint32_t i = group[g];
+            int fileRet = compile_batch_file(&tokenizer, srcs[i], outs[i], &index, outBuf);
+
+            printf("%s %s\n", fileRet == 0 ? "ok" : "error", srcs[i]);
+            failed += (fileRet != 0);
+        }
+        progIdx_free(&index);
+    }
+
+    tknzr_close(&tokenizer);
+    mem_free(group);
+    mem_free(groupSrcs);
+    mem_free(done);
+    for (uint32_t i = 0; i < count; i++) {
+        mem_free(srcs[i]);
+        mem_free(outs[i]);
+    }
+    mem_free(srcs);
+    mem_free(outs);
+
+    if (ret == 0 && failed > 0) {
+        ret = -EINVAL;
+    }
+
+    return ret;
+}
+
+// Tool mode: writes the signatures of a file or of all files in a
+// directory to a signature file that later compiles can load with --index
+int emit_index(const char* inputPath, const char* indexPath)
+{
+    int ret;
+    char** paths = NULL;
+    uint32_t count = 1;
+    struct stat st;
+    ProgramIndex index;
+
+    if (stat(inputPath, &st) == 0 && S_ISDIR(st.st_mode)) {
+        ret = collect_sources(inputPath, &paths, &count);
+        if (ret < 0) {
+            return ret;
+        }
+        ret = progIdx_build(&index, (const char* const*)paths, count, worker_count(), false);
+    }
+    else {
+        ret = progIdx_build(&index, &inputPath, 1, 1, false);
+    }
+
+    if (ret == 0) {
+        ret = sigFile_write(&index, indexPath);
+    }
+    progIdx_free(&index);
+
+    if (paths != NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            mem_free(paths[i]);
+        }
+        mem_free(paths);
+    }
+
+    return ret;
+}
+
+int compile_source(const char* path, FILE* out, const char* outPath, const ProgramIndex* index)
 {
     int ret;
     Tokenizer tokenizer;
-    compEng compEng;
-    char tokStr[100];
-    const char* inputPath;
 
-    if (argc != 2) {
-        LOG_ERR("Please provide input file or directory\n");
+    if (memStats) {
+        mem_fileBegin();
     }
 
-    // Create objects
-    ret = tknzr_new(&tokenizer, argv[1]);
+    ret = tknzr_new(&tokenizer, path);
     if (ret < 0) {
         return ret;
     }
 
-    ret = compEng_new(&compEng, &tokenizer);
+    ret = compile_tokens(&tokenizer, out, outPath, index);
+    if (memStats) {
+        mem_filePrint(path);
+    }
+
+    tknzr_close(&tokenizer);
+    return ret;
+}
+
+// Compiles the file loaded into 'tokenizer', which is left open so its
+// buffers can be reused. With --depfile and an 'outPath' a depfile is
+// written next to the output
+int compile_tokens(Tokenizer* t, FILE* out, const char* outPath, const ProgramIndex* index)
+{
+    int ret = 0;
+    compEng compEng;
+    CostReport cost;
+    DepSet deps;
+
+    ret = compEng_new(&compEng, t, out, index);
     if (ret < 0) {
         return ret;
     }
 
+    if (costReport) {
+        cost_new(&cost);
+        compEng.cost = &cost;
+    }
+
+    if (libraryLoaded) {
+        compEng.library = &library;
+    }
+
+    if (depfile && outPath != NULL) {
+        dep_new(&deps);
+        compEng.deps = &deps;
+    }
+
     // Start compilation process
-    while (tknzr_has_more_tokens(&tokenizer)) {
-        tknzr_advance(&tokenizer);
+    while (tknzr_has_more_tokens(t) && ret == 0) {
+        tknzr_advance(t);
 
-        switch(tokenizer.currTok.type) {
+        switch(t->currTok.type) {
             case TOK_TYPE_KEYWORD:
-                ret = processKeyword(&tokenizer, &compEng);
+                ret = processKeyword(t, &compEng);
                 break;
             case TOK_TYPE_SYMBOL:
                 break;
@@ -63,24 +892,48 @@ int main(int argc, char **argv)
     if (ret < 0) {
         switch (ret) {
             case -EINVAL:
-                LOG_ERR("Parse Error: Did not get expected token");
+                compEng_reportError(&compEng, t->currTok.start,
+                                    "Parse Error: Did not get expected token");
             default:
                 break;
         }
     }
 
-    tknzr_close(&tokenizer);
+    if (compEng_printDiagnostics(&compEng) > 0 && ret == 0) {
+        ret = -EINVAL;
+    }
+
+    if (compEng.droppedSubroutines > 0) {
+        printf("%s: dropped %u unreachable subroutines (%lu bytes)\n", t->path,
+               compEng.droppedSubroutines, (unsigned long)compEng.droppedBytes);
+    }
+
+    if (costReport) {
+        cost_print(&cost, t);
+        cost_close(&cost);
+    }
+
+    if (compEng.deps != NULL) {
+        DepLookup lookup = {
+            .index = index,
+            .library = compEng.library,
+            .libraryPath = libraryPath,
+            .signatures = depSignatures,
+        };
+        if (ret == 0) {
+            ret = dep_write(&deps, outPath, t->path, compEng.className, &lookup);
+        }
+        dep_close(&deps);
+    }
+
     compEng_close(&compEng);
 
     return ret;
 }
 
-/*****************************************************************************/
-/* PRIVATE FUNCTIONS */
-/*****************************************************************************/
 int processKeyword(Tokenizer* t, compEng* eng)
 {
-    int ret;
+    int ret = 0;
 
     switch (t->currTok.keyword) {
         case KW_CLASS:
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "memory.h"
+#include "err_handler.h"
+
+// Kept in front of every block, sized to preserve malloc's alignment
+typedef union MemHeader {
+    struct {
+        size_t       size;
+        MemSubsystem sub;
+    };
+    max_align_t align;
+} MemHeader;
+
+/*****************************************************************************/
+/* PRIVATE VARIABLES */
+/*****************************************************************************/
+static const char* subsystemNames[MEM_SUBSYSTEM_COUNT] = {
+    "tokenizer", "engine", "index", "driver"
+};
+
+static atomic_uint_fast64_t live[MEM_SUBSYSTEM_COUNT];
+static atomic_uint_fast64_t peak[MEM_SUBSYSTEM_COUNT];
+static atomic_uint_fast64_t totalLive;
+static atomic_uint_fast64_t totalPeak;
+static atomic_bool          budgetReported;
+static uint64_t             budget = 0;
+
+// Usage of the file compiled by this thread, see mem_fileBegin()
+static _Thread_local int64_t fileLive[MEM_SUBSYSTEM_COUNT];
+static _Thread_local int64_t filePeak[MEM_SUBSYSTEM_COUNT];
+static _Thread_local int64_t fileTotal;
+static _Thread_local int64_t fileTotalPeak;
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+static void update_peak(atomic_uint_fast64_t* p, uint64_t value)
+{
+    uint64_t curr = atomic_load(p);
+
+    while (value > curr && !atomic_compare_exchange_weak(p, &curr, value)) {
+    }
+}
+
+static void file_charge(MemSubsystem sub, uint64_t size)
+{
+    fileLive[sub] += size;
+    fileTotal += size;
+    if (fileLive[sub] > filePeak[sub]) {
+        filePeak[sub] = fileLive[sub];
+    }
+    if (fileTotal > fileTotalPeak) {
+        fileTotalPeak = fileTotal;
+    }
+}
+
+// Reserves 'size' bytes against the budget
+static bool reserve(MemSubsystem sub, size_t size)
+{
+    uint64_t total = atomic_fetch_add(&totalLive, size) + size;
+
+    if (budget != 0 && total > budget) {
+        atomic_fetch_sub(&totalLive, size);
+        if (!atomic_exchange(&budgetReported, true)) {
+            LOG_ERR("Memory budget of %lu bytes exceeded", (unsigned long)budget);
+        }
+        return false;
+    }
+
+    update_peak(&totalPeak, total);
+    update_peak(&peak[sub], atomic_fetch_add(&live[sub], size) + size);
+
+    file_charge(sub, size);
+
+    return true;
+}
+
+static void release(MemSubsystem sub, size_t size)
+{
+    atomic_fetch_sub(&totalLive, size);
+    atomic_fetch_sub(&live[sub], size);
+    fileLive[sub] -= size;
+    fileTotal -= size;
+}
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+void* mem_alloc(MemSubsystem sub, size_t size)
+{
+    MemHeader* h;
+
+    if (!reserve(sub, size)) {
+        return NULL;
+    }
+
+    h = malloc(sizeof(MemHeader) + size);
+    if (h == NULL) {
+        release(sub, size);
+        return NULL;
+    }
+
+    h->size = size;
+    h->sub = sub;
+    return h + 1;
+}
+
+void* mem_calloc(MemSubsystem sub, size_t count, size_t size)
+{
+    void* p;
+
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    p = mem_alloc(sub, count * size);
+    if (p != NULL) {
+        memset(p, 0, count * size);
+    }
+
+    return p;
+}
+
+void* mem_realloc(MemSubsystem sub, void* p, size_t size)
+{
+    MemHeader* h;
+    MemHeader* grown;
+
+    if (p == NULL) {
+        return mem_alloc(sub, size);
+    }
+
+    h = (MemHeader*)p - 1;
+    if (size > h->size && !reserve(h->sub, size - h->size)) {
+        return NULL;
+    }
+
+    grown = realloc(h, sizeof(MemHeader) + size);
+    if (grown == NULL) {
+        if (size > h->size) {
+            release(h->sub, size - h->size);
+        }
+        return NULL;
+    }
+
+    if (size < grown->size) {
+        release(grown->sub, grown->size - size);
+    }
+    grown->size = size;
+
+    return grown + 1;
+}
+
+char* mem_strdup(MemSubsystem sub, const char* s)
+{
+    size_t len = strlen(s) + 1;
+    char*  copy = mem_alloc(sub, len);
+
+    if (copy != NULL) {
+        memcpy(copy, s, len);
+    }
+
+    return copy;
+}
+
+void mem_free(void* p)
+{
+    MemHeader* h;
+
+    if (p == NULL) {
+        return;
+    }
+
+    h = (MemHeader*)p - 1;
+    release(h->sub, h->size);
+    free(h);
+}
+
+void mem_setBudget(uint64_t bytes)
+{
+    budget = bytes;
+}
+
+void mem_fileBegin(void)
+{
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        fileLive[i] = 0;
+        filePeak[i] = 0;
+    }
+    fileTotal = 0;
+    fileTotalPeak = 0;
+}
+
+void mem_fileHold(const void* p)
+{
+    if (p != NULL) {
+        const MemHeader* h = (const MemHeader*)p - 1;
+        file_charge(h->sub, h->size);
+    }
+}
+
+void mem_filePrint(const char* path)
+{
+    char line[256];
+    int len = snprintf(line, sizeof(line), "%s: peak %lu bytes (", path,
+                       (unsigned long)fileTotalPeak);
+
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT && len < (int)sizeof(line); i++) {
+        len += snprintf(&line[len], sizeof(line) - len, "%s%s %lu", i > 0 ? ", " : "",
+                        subsystemNames[i], (unsigned long)filePeak[i]);
+    }
+
+    // One call, so lines of files compiled in parallel don't mix
+    printf("%s)\n", line);
+}
+
+void mem_printStats(void)
+{
+    printf("Memory usage (bytes):\n");
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        printf("  %-10s live %10lu  peak %10lu\n", subsystemNames[i],
+               (unsigned long)atomic_load(&live[i]), (unsigned long)atomic_load(&peak[i]));
+    }
+    printf("  %-10s live %10lu  peak %10lu\n", "total",
+           (unsigned long)atomic_load(&totalLive), (unsigned long)atomic_load(&totalPeak));
+}
@@ -0,0 +1,38 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// All heap allocations of the compiler go through these functions, so that
+// usage can be tracked per subsystem and bounded by a budget. Allocations
+// fail (return NULL) instead of exceeding the budget.
+
+typedef enum MemSubsystem {
+    MEM_TOKENIZER,
+    MEM_ENGINE,
+    MEM_INDEX,
+    MEM_DRIVER,
+
+    MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+void* mem_alloc(MemSubsystem sub, size_t size);
+void* mem_calloc(MemSubsystem sub, size_t count, size_t size);
+void* mem_realloc(MemSubsystem sub, void* p, size_t size);
+char* mem_strdup(MemSubsystem sub, const char* s);
+void  mem_free(void* p);
+
+// Total live bytes allowed across all subsystems, 0 for no limit
+void mem_setBudget(uint64_t bytes);
+
+// Per-file usage per subsystem, tracked for the calling thread from
+// mem_fileBegin() on. Blocks kept from a previous file and used again are
+// added with mem_fileHold(), NULL is ignored
+void mem_fileBegin(void);
+void mem_fileHold(const void* p);
+void mem_filePrint(const char* path);
+
+void mem_printStats(void);
+
+#endif // MEMORY_H
@@ -2,23 +2,33 @@
 
 int write_output(compEng* eng, const char* s)
 {
+    if (eng->suppressOutput) {
+        eng->droppedBytes += eng->recurseLevel + strlen(s);
+        return 0;
+    }
+
     for (uint8_t i = 0; i < eng->recurseLevel; i++) {
-        printf("\t");
+        fprintf(eng->outputFile, "\t");
     }
 
-    printf("%s", s);
+    fprintf(eng->outputFile, "%s", s);
     return 0;
 }
 
 int write_output_n(compEng* eng, const char* s, int n)
 {
+    if (eng->suppressOutput) {
+        eng->droppedBytes += eng->recurseLevel + n;
+        return 0;
+    }
+
     for (uint8_t i = 0; i < eng->recurseLevel; i++) {
-        printf("\t");
+        fprintf(eng->outputFile, "\t");
     }
 
     char buffer[100];
     snprintf(buffer, n + 1, "%s", s);
-    printf("%s", buffer);
+    fprintf(eng->outputFile, "%s", buffer);
     return 0;
 }
 
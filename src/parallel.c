@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "parallel.h"
+#include "jobserver.h"
+#include "err_handler.h"
+
+typedef struct ParallelCtx {
+    parallel_job_fn job;
+    void*           jobCtx;
+    uint32_t        count;
+    atomic_uint     nextIdx;
+    atomic_int      firstErr;
+    pthread_t       threads[PARALLEL_MAX_WORKERS];
+    uint16_t        threadsCount;
+    uint16_t        maxWorkers;
+} ParallelCtx;
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+static void run_jobs(ParallelCtx* p, bool spawnWithTokens);
+
+static void* worker(void* arg)
+{
+    run_jobs(arg, false);
+
+    // Give the job slot back as soon as there is nothing left to do
+    if (jobserver_active()) {
+        jobserver_release();
+    }
+
+    return NULL;
+}
+
+static bool spawn_worker(ParallelCtx* p)
+{
+    if (pthread_create(&p->threads[p->threadsCount], NULL, worker, p) != 0) {
+        return false;
+    }
+
+    p->threadsCount++;
+    return true;
+}
+
+// With a jobserver, extra workers are only started while make hands out
+// tokens. This is retried before every job of the calling thread, so
+// workers are added as soon as other jobs of the build finish
+static void spawn_workers_with_tokens(ParallelCtx* p, uint32_t nextIdx)
+{
+    while (p->threadsCount + 1 < p->maxWorkers
+            && nextIdx + p->threadsCount + 1 < p->count
+            && jobserver_try_acquire())
+    {
+        if (!spawn_worker(p)) {
+            jobserver_release();
+            break;
+        }
+    }
+}
+
+static void run_jobs(ParallelCtx* p, bool spawnWithTokens)
+{
+    uint32_t idx;
+
+    while ((idx = atomic_fetch_add(&p->nextIdx, 1)) < p->count) {
+        if (spawnWithTokens) {
+            spawn_workers_with_tokens(p, idx);
+        }
+
+        int ret = p->job(p->jobCtx, idx);
+        if (ret < 0) {
+            int expected = 0;
+            atomic_compare_exchange_strong(&p->firstErr, &expected, ret);
+        }
+    }
+}
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+int parallel_for(uint32_t count, uint16_t maxWorkers, parallel_job_fn job, void* ctx)
+{
+    ParallelCtx p = {
+        .job = job,
+        .jobCtx = ctx,
+        .count = count,
+        .threadsCount = 0,
+        .maxWorkers = maxWorkers,
+    };
+
+    atomic_init(&p.nextIdx, 0);
+    atomic_init(&p.firstErr, 0);
+
+    if (p.maxWorkers > PARALLEL_MAX_WORKERS) {
+        p.maxWorkers = PARALLEL_MAX_WORKERS;
+    }
+    if (p.maxWorkers > count) {
+        p.maxWorkers = count;
+    }
+
+    // The calling thread is one of the workers and uses the job slot the
+    // process already owns
+    if (!jobserver_active()) {
+        for (uint16_t i = 1; i < p.maxWorkers; i++) {
+            if (!spawn_worker(&p)) {
+                break;
+            }
+        }
+    }
+
+    run_jobs(&p, jobserver_active());
+
+    for (uint16_t i = 0; i < p.threadsCount; i++) {
+        pthread_join(p.threads[i], NULL);
+    }
+
+    return atomic_load(&p.firstErr);
+}
+
+uint16_t parallel_default_workers(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (n < 1) {
+        return 1;
+    }
+    if (n > PARALLEL_MAX_WORKERS) {
+        return PARALLEL_MAX_WORKERS;
+    }
+
+    return (uint16_t)n;
+}
@@ -0,0 +1,19 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+
+#define PARALLEL_MAX_WORKERS    64
+
+// Job called once for every index in [0, count). Returns < 0 on error
+typedef int (*parallel_job_fn)(void* ctx, uint32_t idx);
+
+// Runs 'job' for every index in [0, count) on up to 'maxWorkers' threads,
+// including the calling one. Every index is always processed, even if some
+// jobs fail. Returns 0 or the error of the first failed job.
+int parallel_for(uint32_t count, uint16_t maxWorkers, parallel_job_fn job, void* ctx);
+
+// Number of online processors, used as default worker count
+uint16_t parallel_default_workers(void);
+
+#endif // PARALLEL_H
@@ -0,0 +1,497 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "program_index.h"
+#include "parallel.h"
+#include "err_handler.h"
+#include "memory.h"
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+typedef struct ScanCtx {
+    ProgramIndex*      idx;
+    const char* const* paths;
+    const uint32_t*    pending;     // Classes to scan, NULL for all
+    bool               collectCalls;
+} ScanCtx;
+
+typedef struct ReachItem {
+    const ClassSig* cls;
+    SubroutineSig*  sub;
+} ReachItem;
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+static bool name_equals(const char* name, const char* s, uint16_t len)
+{
+    if (len > MAX_IDENTIFIER_STR_LEN) {
+        return false;
+    }
+
+    return strncmp(name, s, len) == 0 && name[len] == '\0';
+}
+
+// Advances to the next token, returns false when the source is exhausted
+static bool next_token(Tokenizer* t)
+{
+    if (!tknzr_has_more_tokens(t)) {
+        return false;
+    }
+
+    tknzr_advance(t);
+    return true;
+}
+
+static bool is_symbol_tok(Tokenizer* t, char sym)
+{
+    return t->currTok.type == TOK_TYPE_SYMBOL && t->content[t->currTok.start] == sym;
+}
+
+// Counts the names declared up to the closing ';' of a
+// classVarDec, current token being the type
+static uint16_t count_declared_names(Tokenizer* t)
+{
+    uint16_t count = 1;
+
+    while (next_token(t) && !is_symbol_tok(t, ';')) {
+        if (is_symbol_tok(t, ',')) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static int add_subroutine(ClassSig* cls, SubroutineSig* sig)
+{
+    if (cls->subroutinesCount == cls->subroutinesCap) {
+        uint16_t newCap = cls->subroutinesCap ? cls->subroutinesCap * 2 : 16;
+        SubroutineSig* subs = mem_realloc(MEM_INDEX, cls->subroutines, newCap * sizeof(SubroutineSig));
+        if (subs == NULL) {
+            return -ENOMEM;
+        }
+        cls->subroutines = subs;
+        cls->subroutinesCap = newCap;
+    }
+
+    cls->subroutines[cls->subroutinesCount++] = *sig;
+    return 0;
+}
+
+static int add_call(SubroutineSig* sig, Tokenizer* t, const Token* qualifier, const Token* name)
+{
+    if (sig->callsCount == sig->callsCap) {
+        uint16_t newCap = sig->callsCap ? sig->callsCap * 2 : 8;
+        CallRef* calls = mem_realloc(MEM_INDEX, sig->calls, newCap * sizeof(CallRef));
+        if (calls == NULL) {
+            return -ENOMEM;
+        }
+        sig->calls = calls;
+        sig->callsCap = newCap;
+    }
+
+    CallRef* call = &sig->calls[sig->callsCount++];
+    call->qualifier[0] = '\0';
+    call->name[0] = '\0';
+    if (qualifier != NULL) {
+        tknzr_get_token_str(t, qualifier, call->qualifier, sizeof(call->qualifier));
+    }
+    tknzr_get_token_str(t, name, call->name, sizeof(call->name));
+
+    return 0;
+}
+
+// Walks a subroutine body, current token being its '{', and records every
+// subroutineName '(' and (className|varName) '.' subroutineName '('
+static int scan_body_calls(Tokenizer* t, SubroutineSig* sig)
+{
+    int      ret;
+    uint32_t depth = 1;
+    Token    hist[3] = { t->currTok, t->currTok, t->currTok };
+
+    while (depth > 0 && next_token(t)) {
+        if (is_symbol_tok(t, '{')) {
+            depth++;
+        }
+        else if (is_symbol_tok(t, '}')) {
+            depth--;
+        }
+        else if (is_symbol_tok(t, '(') && hist[2].type == TOK_TYPE_IDENTIFIER) {
+            bool qualified = hist[1].type == TOK_TYPE_SYMBOL
+                             && t->content[hist[1].start] == '.'
+                             && hist[0].type == TOK_TYPE_IDENTIFIER;
+
+            EXIT_ON_ERR(add_call(sig, t, qualified ? &hist[0] : NULL, &hist[2]));
+        }
+
+        hist[0] = hist[1];
+        hist[1] = hist[2];
+        hist[2] = t->currTok;
+    }
+
+    return 0;
+}
+
+// Rule (bodies are skipped or only scanned for calls):
+// 'class' className '{' classVarDec* subroutineDec* '}'
+static int scan_class(Tokenizer* t, ClassSig* cls, bool collectCalls)
+{
+    int ret;
+
+    if (!next_token(t) || t->currTok.keyword != KW_CLASS) {
+        return -EINVAL;
+    }
+    if (!next_token(t) || t->currTok.type != TOK_TYPE_IDENTIFIER) {
+        return -EINVAL;
+    }
+    tknzr_get_string_val(t, cls->name, sizeof(cls->name));
+
+    if (!next_token(t) || !is_symbol_tok(t, '{') || !next_token(t)) {
+        return -EINVAL;
+    }
+
+    while (t->currTok.keyword == KW_STATIC || t->currTok.keyword == KW_FIELD) {
+        Keyword kw = t->currTok.keyword;
+
+        if (!next_token(t)) {
+            return -EINVAL;
+        }
+        if (kw == KW_STATIC) {
+            cls->nStatics += count_declared_names(t);
+        }
+        else {
+            cls->nFields += count_declared_names(t);
+        }
+
+        if (!next_token(t)) {
+            return -EINVAL;
+        }
+    }
+
+    while (t->currTok.keyword == KW_CONSTRUCTOR
+            || t->currTok.keyword == KW_FUNCTION
+            || t->currTok.keyword == KW_METHOD)
+    {
+        SubroutineSig sig = { .kind = t->currTok.keyword, .nParams = 0 };
+
+        // Return type followed by name
+        if (!next_token(t) || !next_token(t) || t->currTok.type != TOK_TYPE_IDENTIFIER) {
+            return -EINVAL;
+        }
+        tknzr_get_string_val(t, sig.name, sizeof(sig.name));
+
+        if (!next_token(t) || !is_symbol_tok(t, '(') || !next_token(t)) {
+            return -EINVAL;
+        }
+        if (!is_symbol_tok(t, ')')) {
+            sig.nParams = 1;
+            while (next_token(t) && !is_symbol_tok(t, ')')) {
+                if (is_symbol_tok(t, ',')) {
+                    sig.nParams++;
+                }
+            }
+        }
+
+        if (!next_token(t) || !is_symbol_tok(t, '{')) {
+            return -EINVAL;
+        }
+
+        if (collectCalls) {
+            ret = scan_body_calls(t, &sig);
+            if (ret < 0) {
+                mem_free(sig.calls);
+                return ret;
+            }
+        }
+        else {
+            tknzr_skip_block(t);
+        }
+
+        ret = add_subroutine(cls, &sig);
+        if (ret < 0) {
+            mem_free(sig.calls);
+            return ret;
+        }
+
+        if (!next_token(t)) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+// Only running out of memory fails the index pass. Files that can't be
+// read or parsed are left out of the index and reported by the second pass
+static int scan_job(void* ctx, uint32_t job)
+{
+    int ret;
+    ScanCtx*  scan = ctx;
+    uint32_t  i = scan->pending ? scan->pending[job] : job;
+    ClassSig* cls = &scan->idx->classes[i];
+    Tokenizer t;
+
+    cls->path = scan->paths[i];
+
+    // Missing files are reported once, by the second pass
+    if (access(scan->paths[i], F_OK) != 0) {
+        cls->name[0] = '\0';
+        return 0;
+    }
+
+    ret = tknzr_new(&t, scan->paths[i]);
+    if (ret == 0) {
+        ret = scan_class(&t, cls, scan->collectCalls);
+    }
+    if (ret < 0) {
+        // Malformed header, leave class out of the index
+        cls->name[0] = '\0';
+    }
+
+    tknzr_close(&t);
+    return ret == -ENOMEM ? ret : 0;
+}
+
+static int build_slots(ProgramIndex* idx)
+{
+    idx->slotsCount = 16;
+    while (idx->slotsCount < idx->classesCount * 2) {
+        idx->slotsCount *= 2;
+    }
+
+    idx->slots = mem_alloc(MEM_INDEX, idx->slotsCount * sizeof(uint32_t));
+    if (idx->slots == NULL) {
+        return -ENOMEM;
+    }
+    memset(idx->slots, 0xFF, idx->slotsCount * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < idx->classesCount; i++) {
+        const char* name = idx->classes[i].name;
+        uint16_t    len = strlen(name);
+        if (len == 0) {
+            continue;
+        }
+
+        uint32_t s = progIdx_hashName(name, len) & (idx->slotsCount - 1);
+        while (idx->slots[s] != PROG_IDX_INVALID_SLOT) {
+            s = (s + 1) & (idx->slotsCount - 1);
+        }
+        idx->slots[s] = i;
+    }
+
+    return 0;
+}
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+int progIdx_build(ProgramIndex* idx, const char* const* paths, uint32_t count,
+                  uint16_t workers, bool collectCalls)
+{
+    int ret;
+    ScanCtx scan = { .idx = idx, .paths = paths, .collectCalls = collectCalls };
+
+    idx->classesCount = count;
+    idx->slots = NULL;
+    idx->hasReachability = false;
+    idx->classes = mem_calloc(MEM_INDEX, count, sizeof(ClassSig));
+    if (idx->classes == NULL) {
+        LOG_ERR("Failed allocating memory\n");
+        return -ENOMEM;
+    }
+
+    ret = parallel_for(count, workers, scan_job, &scan);
+    if (ret < 0) {
+        return ret;
+    }
+
+    return build_slots(idx);
+}
+
+int progIdx_update(ProgramIndex* idx, ProgramIndex* prev, const char* const* paths,
+                   uint32_t count, bool* rescan, uint16_t workers, bool collectCalls)
+{
+    int ret;
+    uint32_t j = 0;
+    uint32_t pendingCount = 0;
+    uint32_t* pending;
+    ScanCtx scan = { .idx = idx, .paths = paths, .collectCalls = collectCalls };
+
+    idx->classesCount = count;
+    idx->slots = NULL;
+    idx->hasReachability = false;
+    idx->classes = mem_calloc(MEM_INDEX, count, sizeof(ClassSig));
+    pending = mem_alloc(MEM_INDEX, count * sizeof(uint32_t));
+    if (idx->classes == NULL || pending == NULL) {
+        mem_free(pending);
+        LOG_ERR("Failed allocating memory\n");
+        return -ENOMEM;
+    }
+
+    // Both path lists are sorted, so the previous class of a file is found
+    // by walking them side by side
+    for (uint32_t i = 0; i < count; i++) {
+        while (j < prev->classesCount && strcmp(prev->classes[j].path, paths[i]) < 0) {
+            j++;
+        }
+
+        ClassSig* old = NULL;
+        if (j < prev->classesCount && strcmp(prev->classes[j].path, paths[i]) == 0) {
+            old = &prev->classes[j];
+        }
+
+        if (old == NULL || rescan[i]) {
+            rescan[i] = true;
+            pending[pendingCount++] = i;
+            continue;
+        }
+
+        // Move the class, leaving an empty entry in 'prev'
+        idx->classes[i] = *old;
+        idx->classes[i].path = paths[i];
+        old->name[0] = '\0';
+        old->subroutines = NULL;
+        old->subroutinesCount = 0;
+        old->subroutinesCap = 0;
+    }
+
+    scan.pending = pending;
+    ret = parallel_for(pendingCount, workers, scan_job, &scan);
+    mem_free(pending);
+    if (ret < 0) {
+        return ret;
+    }
+
+    return build_slots(idx);
+}
+
+uint32_t progIdx_hashName(const char* s, uint16_t len)
+{
+    uint32_t h = FNV_OFFSET_BASIS;
+
+    for (uint16_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * FNV_PRIME;
+    }
+
+    return h;
+}
+
+void progIdx_free(ProgramIndex* idx)
+{
+    if (idx->classes != NULL) {
+        for (uint32_t i = 0; i < idx->classesCount; i++) {
+            ClassSig* cls = &idx->classes[i];
+            for (uint16_t j = 0; j < cls->subroutinesCount; j++) {
+                mem_free(cls->subroutines[j].calls);
+            }
+            mem_free(cls->subroutines);
+        }
+        mem_free(idx->classes);
+        idx->classes = NULL;
+    }
+
+    mem_free(idx->slots);
+    idx->slots = NULL;
+}
+
+const ClassSig* progIdx_findClass(const ProgramIndex* idx, const char* name, uint16_t nameLen)
+{
+    if (idx == NULL || idx->slots == NULL) {
+        return NULL;
+    }
+
+    uint32_t s = progIdx_hashName(name, nameLen) & (idx->slotsCount - 1);
+    while (idx->slots[s] != PROG_IDX_INVALID_SLOT) {
+        const ClassSig* cls = &idx->classes[idx->slots[s]];
+        if (name_equals(cls->name, name, nameLen)) {
+            return cls;
+        }
+        s = (s + 1) & (idx->slotsCount - 1);
+    }
+
+    return NULL;
+}
+
+const SubroutineSig* progIdx_findSubroutine(const ClassSig* cls, const char* name, uint16_t nameLen)
+{
+    for (uint16_t i = 0; i < cls->subroutinesCount; i++) {
+        if (name_equals(cls->subroutines[i].name, name, nameLen)) {
+            return &cls->subroutines[i];
+        }
+    }
+
+    return NULL;
+}
+
+int progIdx_markReachable(ProgramIndex* idx, const char* className, const char* subName)
+{
+    uint32_t   total = 0;
+    uint32_t   top = 0;
+    ReachItem* stack;
+    ClassSig*  cls;
+    SubroutineSig* root;
+
+    // Classes taken over by progIdx_update() still carry earlier results
+    for (uint32_t i = 0; i < idx->classesCount; i++) {
+        for (uint16_t j = 0; j < idx->classes[i].subroutinesCount; j++) {
+            idx->classes[i].subroutines[j].reachable = false;
+        }
+    }
+
+    cls = (ClassSig*)progIdx_findClass(idx, className, strlen(className));
+    root = cls ? (SubroutineSig*)progIdx_findSubroutine(cls, subName, strlen(subName)) : NULL;
+    if (root == NULL) {
+        LOG_ERR("No entry point %s.%s, keeping all subroutines", className, subName);
+        return -ENOENT;
+    }
+
+    // Every subroutine is pushed at most once
+    for (uint32_t i = 0; i < idx->classesCount; i++) {
+        total += idx->classes[i].subroutinesCount;
+    }
+    stack = mem_alloc(MEM_INDEX, total * sizeof(ReachItem));
+    if (stack == NULL) {
+        return -ENOMEM;
+    }
+
+    root->reachable = true;
+    stack[top++] = (ReachItem){ .cls = cls, .sub = root };
+
+    while (top > 0) {
+        ReachItem item = stack[--top];
+
+        for (uint16_t i = 0; i < item.sub->callsCount; i++) {
+            const CallRef*  call = &item.sub->calls[i];
+            const ClassSig* target = item.cls;
+
+            if (call->qualifier[0] != '\0') {
+                target = progIdx_findClass(idx, call->qualifier, strlen(call->qualifier));
+            }
+
+            // Calls through a variable can't be resolved without types,
+            // keep every method with that name
+            for (uint32_t c = 0; c < idx->classesCount; c++) {
+                ClassSig* candidate = &idx->classes[c];
+                if (target != NULL && target != candidate) {
+                    continue;
+                }
+
+                SubroutineSig* sub = (SubroutineSig*)progIdx_findSubroutine(
+                    candidate, call->name, strlen(call->name));
+                if (sub == NULL || sub->reachable
+                        || (target == NULL && sub->kind != KW_METHOD)) {
+                    continue;
+                }
+
+                sub->reachable = true;
+                stack[top++] = (ReachItem){ .cls = candidate, .sub = sub };
+            }
+        }
+    }
+
+    mem_free(stack);
+    idx->hasReachability = true;
+    return 0;
+}
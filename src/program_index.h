@@ -0,0 +1,77 @@
+#ifndef PROGRAM_INDEX_H
+#define PROGRAM_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tokenizer.h"
+
+#define PROG_IDX_INVALID_SLOT   0xFFFFFFFF
+
+// Call found in a subroutine body, only collected for reachability analysis
+typedef struct CallRef {
+    char qualifier[MAX_IDENTIFIER_STR_LEN + 1];  // Class or variable, may be empty
+    char name[MAX_IDENTIFIER_STR_LEN + 1];
+} CallRef;
+
+typedef struct SubroutineSig {
+    char     name[MAX_IDENTIFIER_STR_LEN + 1];
+    Keyword  kind;      // KW_CONSTRUCTOR, KW_FUNCTION or KW_METHOD
+    uint8_t  nParams;
+    bool     reachable;
+    CallRef* calls;
+    uint16_t callsCount;
+    uint16_t callsCap;
+} SubroutineSig;
+
+typedef struct ClassSig {
+    char           name[MAX_IDENTIFIER_STR_LEN + 1];
+    const char*    path;
+    uint16_t       nStatics;
+    uint16_t       nFields;
+    SubroutineSig* subroutines;
+    uint16_t       subroutinesCount;
+    uint16_t       subroutinesCap;
+} ClassSig;
+
+// Signatures of all classes taking part in a compilation. It is filled by a
+// first pass that only looks at class headers, variable declarations and
+// subroutine declarations, and is read-only while the bodies are compiled.
+typedef struct ProgramIndex {
+    ClassSig* classes;
+    uint32_t  classesCount;
+    uint32_t* slots;        // Open addressing hash table into 'classes'
+    uint32_t  slotsCount;   // Always a power of two
+    bool      hasReachability;
+} ProgramIndex;
+
+// Scans the files in 'paths' in parallel on up to 'workers' threads. Files
+// that can't be scanned are left out of the index, their errors are
+// reported when their bodies are compiled. Running out of memory fails the
+// whole build with -ENOMEM. With 'collectCalls' subroutine bodies are
+// scanned for calls instead of being skipped
+int progIdx_build(ProgramIndex* idx, const char* const* paths, uint32_t count,
+                  uint16_t workers, bool collectCalls);
+
+// Builds 'idx' over 'paths' like progIdx_build(), but takes the classes of
+// 'prev' over instead of scanning their files again. Only files flagged in
+// 'rescan' and files 'prev' doesn't know are scanned, the latter get
+// flagged as well. Both indexes must be built over sorted paths. The
+// classes left in 'prev' are the replaced and removed ones, which stay
+// readable until 'prev' is freed
+int progIdx_update(ProgramIndex* idx, ProgramIndex* prev, const char* const* paths,
+                   uint32_t count, bool* rescan, uint16_t workers, bool collectCalls);
+
+// Marks every subroutine reachable from 'className'.'subName' through the
+// collected calls. Requires an index built with 'collectCalls'
+int progIdx_markReachable(ProgramIndex* idx, const char* className, const char* subName);
+
+void progIdx_free(ProgramIndex* idx);
+
+// Hash used for class names, also by the signature files
+uint32_t progIdx_hashName(const char* s, uint16_t len);
+
+const ClassSig* progIdx_findClass(const ProgramIndex* idx, const char* name, uint16_t nameLen);
+
+const SubroutineSig* progIdx_findSubroutine(const ClassSig* cls, const char* name, uint16_t nameLen);
+
+#endif // PROGRAM_INDEX_H
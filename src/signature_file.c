@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "signature_file.h"
+#include "err_handler.h"
+#include "memory.h"
+#include "file_io.h"
+
+#define ALIGN4(x)   (((x) + 3u) & ~3u)
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+static const uint32_t* slots(const SignatureFile* f)
+{
+    return (const uint32_t*)(f->base + f->header->slotsOffset);
+}
+
+static const SigFileClass* classes(const SignatureFile* f)
+{
+    return (const SigFileClass*)(f->base + f->header->classesOffset);
+}
+
+static const SigFileSub* subroutines(const SignatureFile* f)
+{
+    return (const SigFileSub*)(f->base + f->header->subroutinesOffset);
+}
+
+static bool string_equals(const SignatureFile* f, uint32_t offset, uint16_t len,
+                          const char* s, uint16_t sLen)
+{
+    const SigFileHeader* h = f->header;
+
+    if (len != sLen || (uint64_t)offset + len > h->stringsSize) {
+        return false;
+    }
+
+    return memcmp(f->base + h->stringsOffset + offset, s, len) == 0;
+}
+
+static bool section_fits(uint32_t fileSize, uint32_t offset, uint64_t size)
+{
+    return (offset % 4) == 0 && (uint64_t)offset + size <= fileSize;
+}
+
+static uint8_t kind_from_keyword(Keyword kw)
+{
+    switch (kw) {
+        case KW_CONSTRUCTOR:
+            return SIG_KIND_CONSTRUCTOR;
+        case KW_METHOD:
+            return SIG_KIND_METHOD;
+        default:
+            return SIG_KIND_FUNCTION;
+    }
+}
+
+// Lays out all classes of 'idx' in one buffer, in the format of the file
+static int build_image(const ProgramIndex* idx, uint8_t** image, uint32_t* size)
+{
+    SigFileHeader h = { .magic = SIG_FILE_MAGIC, .version = SIG_FILE_VERSION };
+    uint8_t* buf;
+    uint32_t classIdx = 0;
+    uint32_t subIdx = 0;
+    uint32_t strOffset = 0;
+
+    // Size everything up front so the file is built in one buffer
+    for (uint32_t i = 0; i < idx->classesCount; i++) {
+        const ClassSig* cls = &idx->classes[i];
+        if (cls->name[0] == '\0') {
+            continue;
+        }
+
+        h.classesCount++;
+        h.subroutinesCount += cls->subroutinesCount;
+        h.stringsSize += strlen(cls->name);
+        for (uint16_t j = 0; j < cls->subroutinesCount; j++) {
+            h.stringsSize += strlen(cls->subroutines[j].name);
+        }
+    }
+
+    h.slotsCount = 16;
+    while (h.slotsCount < h.classesCount * 2) {
+        h.slotsCount *= 2;
+    }
+
+    h.slotsOffset = ALIGN4(sizeof(SigFileHeader));
+    h.classesOffset = h.slotsOffset + h.slotsCount * sizeof(uint32_t);
+    h.subroutinesOffset = ALIGN4(h.classesOffset + h.classesCount * sizeof(SigFileClass));
+    h.stringsOffset = ALIGN4(h.subroutinesOffset + h.subroutinesCount * sizeof(SigFileSub));
+    h.fileSize = ALIGN4(h.stringsOffset + h.stringsSize);
+
+    buf = mem_calloc(MEM_INDEX, 1, h.fileSize);
+    if (buf == NULL) {
+        LOG_ERR("Failed allocating memory\n");
+        return -ENOMEM;
+    }
+    memcpy(buf, &h, sizeof(h));
+    memset(buf + h.slotsOffset, 0xFF, h.slotsCount * sizeof(uint32_t));
+
+    uint32_t*     outSlots = (uint32_t*)(buf + h.slotsOffset);
+    SigFileClass* outClasses = (SigFileClass*)(buf + h.classesOffset);
+    SigFileSub*   outSubs = (SigFileSub*)(buf + h.subroutinesOffset);
+    char*         outStrings = (char*)(buf + h.stringsOffset);
+
+    for (uint32_t i = 0; i < idx->classesCount; i++) {
+        const ClassSig* cls = &idx->classes[i];
+        uint16_t        len = strlen(cls->name);
+        if (len == 0) {
+            continue;
+        }
+
+        SigFileClass* c = &outClasses[classIdx];
+        c->nameOffset = strOffset;
+        c->nameLen = len;
+        c->subroutinesCount = cls->subroutinesCount;
+        c->firstSubroutine = subIdx;
+        c->nStatics = cls->nStatics;
+        c->nFields = cls->nFields;
+        memcpy(&outStrings[strOffset], cls->name, len);
+        strOffset += len;
+
+        for (uint16_t j = 0; j < cls->subroutinesCount; j++) {
+            const SubroutineSig* sub = &cls->subroutines[j];
+            SigFileSub* s = &outSubs[subIdx++];
+
+            s->nameLen = strlen(sub->name);
+            s->nameOffset = strOffset;
+            s->kind = kind_from_keyword(sub->kind);
+            s->nParams = sub->nParams;
+            memcpy(&outStrings[strOffset], sub->name, s->nameLen);
+            strOffset += s->nameLen;
+        }
+
+        uint32_t slot = progIdx_hashName(cls->name, len) & (h.slotsCount - 1);
+        while (outSlots[slot] != SIG_FILE_INVALID_SLOT) {
+            slot = (slot + 1) & (h.slotsCount - 1);
+        }
+        outSlots[slot] = classIdx++;
+    }
+
+    *image = buf;
+    *size = h.fileSize;
+    return 0;
+}
+
+static int write_image(const uint8_t* buf, uint32_t size, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        LOG_ERR("Could not open output file %s", path);
+        return -EACCES;
+    }
+
+    size_t written = fwrite(buf, size, 1, file);
+    fclose(file);
+
+    return written == 1 ? 0 : -EIO;
+}
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+int sigFile_write(const ProgramIndex* idx, const char* path)
+{
+    uint8_t* buf;
+    uint32_t size;
+    int ret;
+
+    ret = build_image(idx, &buf, &size);
+    if (ret == 0) {
+        ret = write_image(buf, size, path);
+        mem_free(buf);
+    }
+
+    return ret;
+}
+
+int sigFile_writeClass(const ClassSig* cls, const char* path)
+{
+    // Only 'classes' and 'classesCount' are used to build the image
+    ProgramIndex one = { .classes = (ClassSig*)cls, .classesCount = 1 };
+    uint8_t* buf;
+    uint32_t size;
+    char* old = NULL;
+    uint64_t oldCap = 0;
+    uint64_t oldLen = 0;
+    int ret;
+
+    ret = build_image(&one, &buf, &size);
+    if (ret < 0) {
+        return ret;
+    }
+
+    // Leave the file and its mtime alone when the signatures didn't change
+    if (access(path, F_OK) != 0
+            || fileio_read(path, &old, &oldCap, &oldLen, MEM_INDEX) < 0
+            || oldLen != size || memcmp(old, buf, size) != 0)
+    {
+        ret = write_image(buf, size, path);
+    }
+
+    mem_free(old);
+    mem_free(buf);
+    return ret;
+}
+
+int sigFile_open(SignatureFile* f, const char* path)
+{
+    struct stat st;
+    const SigFileHeader* h;
+    int fd;
+
+    f->base = NULL;
+    f->header = NULL;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERR("No such file %s", path);
+        return -ENOENT;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(SigFileHeader)
+            || st.st_size > UINT32_MAX) {
+        close(fd);
+        LOG_ERR("Invalid signature file %s", path);
+        return -EINVAL;
+    }
+
+    f->size = st.st_size;
+    f->base = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (f->base == MAP_FAILED) {
+        f->base = NULL;
+        return -errno;
+    }
+
+    h = (const SigFileHeader*)f->base;
+    if (h->magic != SIG_FILE_MAGIC || h->version != SIG_FILE_VERSION
+            || h->fileSize != f->size
+            || h->slotsCount == 0 || (h->slotsCount & (h->slotsCount - 1)) != 0
+            || !section_fits(f->size, h->slotsOffset, (uint64_t)h->slotsCount * sizeof(uint32_t))
+            || !section_fits(f->size, h->classesOffset, (uint64_t)h->classesCount * sizeof(SigFileClass))
+            || !section_fits(f->size, h->subroutinesOffset, (uint64_t)h->subroutinesCount * sizeof(SigFileSub))
+            || !section_fits(f->size, h->stringsOffset, h->stringsSize))
+    {
+        LOG_ERR("Invalid or incompatible signature file %s", path);
+        sigFile_close(f);
+        return -EINVAL;
+    }
+
+    f->header = h;
+    return 0;
+}
+
+void sigFile_close(SignatureFile* f)
+{
+    if (f->base != NULL) {
+        munmap((void*)f->base, f->size);
+        f->base = NULL;
+        f->header = NULL;
+    }
+}
+
+const SigFileClass* sigFile_findClass(const SignatureFile* f, const char* name, uint16_t nameLen)
+{
+    if (f == NULL || f->header == NULL) {
+        return NULL;
+    }
+
+    const SigFileHeader* h = f->header;
+    uint32_t s = progIdx_hashName(name, nameLen) & (h->slotsCount - 1);
+
+    // Bounded probing, so a corrupt table can't loop forever
+    for (uint32_t probes = 0; probes < h->slotsCount; probes++) {
+        uint32_t c = slots(f)[s];
+        if (c == SIG_FILE_INVALID_SLOT || c >= h->classesCount) {
+            return NULL;
+        }
+
+        const SigFileClass* cls = &classes(f)[c];
+        if (string_equals(f, cls->nameOffset, cls->nameLen, name, nameLen)) {
+            return cls;
+        }
+        s = (s + 1) & (h->slotsCount - 1);
+    }
+
+    return NULL;
+}
+
+const SigFileSub* sigFile_findSubroutine(const SignatureFile* f, const SigFileClass* cls,
+                                         const char* name, uint16_t nameLen)
+{
+    if ((uint64_t)cls->firstSubroutine + cls->subroutinesCount > f->header->subroutinesCount) {
+        return NULL;
+    }
+
+    const SigFileSub* subs = &subroutines(f)[cls->firstSubroutine];
+    for (uint16_t i = 0; i < cls->subroutinesCount; i++) {
+        if (string_equals(f, subs[i].nameOffset, subs[i].nameLen, name, nameLen)) {
+            return &subs[i];
+        }
+    }
+
+    return NULL;
+}
+
+Keyword sigFile_kindKeyword(const SigFileSub* sub)
+{
+    switch (sub->kind) {
+        case SIG_KIND_CONSTRUCTOR:
+            return KW_CONSTRUCTOR;
+        case SIG_KIND_METHOD:
+            return KW_METHOD;
+        default:
+            return KW_FUNCTION;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef SIGNATURE_FILE_H
+#define SIGNATURE_FILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "program_index.h"
+
+// Precompiled signatures of library classes (e.g. the Jack OS), so calls to
+// them can be resolved without parsing their sources. All offsets are
+// relative to the start of the file, which is used directly from an mmap.
+//
+// Layout:
+//   SigFileHeader
+//   uint32_t       slots[slotsCount]   hash table, index into classes
+//   SigFileClass   classes[classesCount]
+//   SigFileSub     subroutines[subroutinesCount]
+//   char           strings[stringsSize]
+#define SIG_FILE_MAGIC          0x5849534A  // "JSIX"
+#define SIG_FILE_VERSION        1
+#define SIG_FILE_INVALID_SLOT   0xFFFFFFFF
+
+typedef enum SigFileKind {
+    SIG_KIND_CONSTRUCTOR,
+    SIG_KIND_FUNCTION,
+    SIG_KIND_METHOD,
+} SigFileKind;
+
+typedef struct SigFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t slotsCount;        // Power of two
+    uint32_t classesCount;
+    uint32_t subroutinesCount;
+    uint32_t stringsSize;
+    uint32_t slotsOffset;
+    uint32_t classesOffset;
+    uint32_t subroutinesOffset;
+    uint32_t stringsOffset;
+} SigFileHeader;
+
+typedef struct SigFileClass {
+    uint32_t nameOffset;        // Into strings
+    uint16_t nameLen;
+    uint16_t subroutinesCount;
+    uint32_t firstSubroutine;
+    uint16_t nStatics;
+    uint16_t nFields;
+} SigFileClass;
+
+typedef struct SigFileSub {
+    uint32_t nameOffset;
+    uint16_t nameLen;
+    uint8_t  kind;              // SigFileKind
+    uint8_t  nParams;
+} SigFileSub;
+
+typedef struct SignatureFile {
+    const uint8_t*       base;
+    uint32_t             size;
+    const SigFileHeader* header;
+} SignatureFile;
+
+// Writes all classes of 'idx' to 'path'
+int sigFile_write(const ProgramIndex* idx, const char* path);
+
+// Writes a file with only 'cls', unless 'path' already holds the same
+// signatures. Used as a stamp that changes only with the class interface
+int sigFile_writeClass(const ClassSig* cls, const char* path);
+
+// Maps 'path' and validates its header, nothing is parsed or allocated
+int sigFile_open(SignatureFile* f, const char* path);
+
+void sigFile_close(SignatureFile* f);
+
+const SigFileClass* sigFile_findClass(const SignatureFile* f, const char* name, uint16_t nameLen);
+
+const SigFileSub* sigFile_findSubroutine(const SignatureFile* f, const SigFileClass* cls,
+                                         const char* name, uint16_t nameLen);
+
+// Keyword of the subroutine kind: KW_CONSTRUCTOR, KW_FUNCTION or KW_METHOD
+Keyword sigFile_kindKeyword(const SigFileSub* sub);
+
+#endif // SIGNATURE_FILE_H
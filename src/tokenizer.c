@@ -1,7 +1,12 @@
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "tokenizer.h"
 #include "err_handler.h"
+#include "memory.h"
+#include "file_io.h"
 
 #define NUMBER_OF_SYMBOLS  sizeof(symbols)
 #define NUMBER_OF_KEYWORDS KW_COUNT
@@ -85,6 +90,58 @@ void remove_whitespace_and_comments(Tokenizer* t)
     }
 }
 
+// Stores the offset following every newline in 'out' (if not NULL) and
+// returns how many there are
+uint32_t scan_newlines(const char* s, uint64_t len, uint32_t* out)
+{
+    uint32_t count = 0;
+    uint64_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)&s[i]);
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+
+        while (mask != 0) {
+            if (out != NULL) {
+                out[count] = i + __builtin_ctz(mask) + 1;
+            }
+            count++;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (s[i] == '\n') {
+            if (out != NULL) {
+                out[count] = i + 1;
+            }
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int build_line_index(Tokenizer* t)
+{
+    uint32_t newlines = scan_newlines(t->content, t->contentLen, NULL);
+
+    t->lineStarts = mem_alloc(MEM_TOKENIZER, (newlines + 1) * sizeof(uint32_t));
+    if (t->lineStarts == NULL) {
+        return -ENOMEM;
+    }
+
+    t->lineStarts[0] = 0;
+    scan_newlines(t->content, t->contentLen, &t->lineStarts[1]);
+    t->linesCount = newlines + 1;
+
+    return 0;
+}
+
 Keyword get_keyword_type(const char* s, uint8_t s_len)
 {
     for (uint8_t i = 0; i < NUMBER_OF_KEYWORDS; i++) {
@@ -95,50 +152,51 @@ Keyword get_keyword_type(const char* s, uint8_t s_len)
     return KW_INVALID;
 }
 
+void init_state(Tokenizer* t, const char* path, uint64_t len)
+{
+    t->path = path;
+    t->contentLen = len;
+    t->cursor = 0;
+    t->currTok = defaultToken;
+    t->prevTok = defaultToken;
+    mem_free(t->lineStarts);
+    t->lineStarts = NULL;
+    t->linesCount = 0;
+
+    // Remove the first encountered whitespace and comments. This has to be done
+    // once at start and will be continued to be done at the end of each token
+    // advance
+    remove_whitespace_and_comments(t);
+}
+
 /*****************************************************************************/
 /* PUBLIC FUNCTIONS */
 /*****************************************************************************/
 
 int tknzr_new(Tokenizer* t, const char* path)
 {
-    FILE* file;
-    uint64_t fileSize;
-    char* buffer = NULL;
+    t->content = NULL;
+    t->contentCap = 0;
+    t->lineStarts = NULL;
 
-    file = fopen(path, "rb");
-    if (NULL == file) {
-        fclose(file);
-        LOG_ERR("No such file %s", path);
-        return -ENOENT;
-    }
+    return tknzr_reset(t, path);
+}
 
-    // Figure out size of file as number of characters
-    fseek(file, 0, SEEK_END);
-    fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
+// Loads another file into an existing tokenizer. The content buffer is
+// kept and only grown when the new file doesn't fit
+int tknzr_reset(Tokenizer* t, const char* path)
+{
+    char* buffer = (char*)t->content;
+    uint64_t len;
+    int ret;
 
-    // Allocate buffer to hold entire file contents
-    buffer = malloc(fileSize + 1);
-    if (buffer == NULL) {
-        fclose(file);
-        LOG_ERR("Failed allocating memory\n");
-        return -ENOMEM;
+    ret = fileio_read(path, &buffer, &t->contentCap, &len, MEM_TOKENIZER);
+    t->content = buffer;
+    if (ret < 0) {
+        return ret;
     }
-    fread(buffer, fileSize, 1, file);
-    fclose(file);
-    buffer[fileSize] = '\0';
 
-    // Initialize members
-    t->content = buffer;
-    t->contentLen = fileSize;
-    t->cursor = 0;
-    t->currTok = defaultToken;
-    t->prevTok = defaultToken;
-
-    // Remove the first encountered whitespace and comments. This has to be done
-    // once at start and will be continued to be done at the end of each token
-    // advance
-    remove_whitespace_and_comments(t);
+    init_state(t, path, len);
 
     return 0;
 }
@@ -146,10 +204,14 @@ int tknzr_new(Tokenizer* t, const char* path)
 void tknzr_close(Tokenizer* t)
 {
     if (t->content != NULL) {
-        free((char*)t->content);
+        mem_free((char*)t->content);
         t->content = NULL;
+        t->contentCap = 0;
     }
 
+    mem_free(t->lineStarts);
+    t->lineStarts = NULL;
+
     return;
 }
 
@@ -229,13 +291,90 @@ void tknzr_advance(Tokenizer *t)
 
 void tknzr_get_string_val(Tokenizer *t, char* dst, uint16_t dstSize)
 {
-    uint16_t strLen = t->currTok.end - t->currTok.start;
+    tknzr_get_token_str(t, &t->currTok, dst, dstSize);
+}
+
+void tknzr_get_token_str(Tokenizer *t, const Token* tok, char* dst, uint16_t dstSize)
+{
+    uint16_t strLen = tok->end - tok->start;
 
     if (dstSize < (strLen + 1)) {
         return;
     }
 
     // Copy to the buffer and add null terminator
-    strncpy(dst, &t->content[t->currTok.start], strLen);
+    strncpy(dst, &t->content[tok->start], strLen);
     dst[strLen] = '\0';
 }
+
+// Skips everything up to and including the '}' that matches the current
+// '{' token, without tokenizing what is in between. Only string literals and
+// comments need to be recognized so braces inside them are not counted.
+// Afterwards the current token is the closing '}'.
+void tknzr_skip_block(Tokenizer *t)
+{
+    uint32_t depth = 1;
+
+    while (!is_EOF(t) && depth > 0) {
+        char c = t->content[t->cursor];
+
+        if (c == '"') {
+            t->cursor++;
+            while (!is_EOF(t) && t->content[t->cursor] != '"') {
+                t->cursor++;
+            }
+        }
+        else if (is_comment_start(t)) {
+            while (!is_EOF(t) && t->content[t->cursor] != '\n') {
+                t->cursor++;
+            }
+            continue;
+        }
+        else if (c == '{') {
+            depth++;
+        }
+        else if (c == '}') {
+            depth--;
+        }
+
+        t->cursor++;
+    }
+
+    t->prevTok = t->currTok;
+    t->currTok.type = TOK_TYPE_SYMBOL;
+    t->currTok.keyword = KW_INVALID;
+    t->currTok.start = t->cursor - 1;
+    t->currTok.end = t->cursor;
+
+    remove_whitespace_and_comments(t);
+}
+
+// Converts a byte offset into a 1-based line and column. Lines are only
+// indexed the first time this is needed, so that compilations without any
+// diagnostics don't pay for it
+void tknzr_get_line_col(Tokenizer *t, uint64_t offset, uint32_t* line, uint32_t* col)
+{
+    uint32_t lo = 0;
+    uint32_t hi;
+
+    if (t->lineStarts == NULL && build_line_index(t) < 0) {
+        *line = 0;
+        *col = 0;
+        return;
+    }
+
+    // Find the last line starting at or before offset
+    hi = t->linesCount;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (t->lineStarts[mid] <= offset) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    *line = lo + 1;
+    *col = offset - t->lineStarts[lo] + 1;
+}
@@ -67,15 +67,21 @@ typedef struct Token {
 } Token;
 
 typedef struct Tokenizer {
+    const char* path;
     const char* content;
     uint64_t contentLen;
+    uint64_t contentCap;
     uint64_t cursor;
     Token currTok;
     Token prevTok;
+    uint32_t* lineStarts;   // Offsets where lines start, built on first use
+    uint32_t linesCount;
 } Tokenizer;
 
 int tknzr_new(Tokenizer *t, const char* path);
 
+int tknzr_reset(Tokenizer *t, const char* path);
+
 void tknzr_close(Tokenizer *t);
 
 bool tknzr_has_more_tokens(Tokenizer *t);
@@ -84,4 +90,10 @@ void tknzr_advance(Tokenizer *t);
 
 void tknzr_get_string_val(Tokenizer *t, char* dst, uint16_t dstSize);
 
+void tknzr_get_token_str(Tokenizer *t, const Token* tok, char* dst, uint16_t dstSize);
+
+void tknzr_skip_block(Tokenizer *t);
+
+void tknzr_get_line_col(Tokenizer *t, uint64_t offset, uint32_t* line, uint32_t* col);
+
 #endif // TOKENIZER_H
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "watcher.h"
+#include "err_handler.h"
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define WATCH_EVENT_MASK    (IN_CLOSE_WRITE | IN_MOVED_TO)
+#define WATCH_PATH_MAX      (PATH_MAX + 1)
+
+// State kept for every source file seen in the watched directory, so that
+// repeated events for an unmodified file don't trigger a recompile
+typedef struct WatchedFile {
+    char            name[NAME_MAX + 1];
+    struct timespec mtime;
+    off_t           size;
+    bool            compiled;
+    bool            pending;
+} WatchedFile;
+
+/*****************************************************************************/
+/* PRIVATE VARIABLES */
+/*****************************************************************************/
+static WatchedFile watchedFiles[WATCH_MAX_FILES];
+static uint16_t    watchedFilesCount = 0;
+
+/*****************************************************************************/
+/* PRIVATE FUNCTIONS */
+/*****************************************************************************/
+static bool has_jack_extension(const char* name)
+{
+    size_t len = strlen(name);
+    return len > 5 && strcmp(&name[len - 5], ".jack") == 0;
+}
+
+static double elapsed_ms(struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0
+           + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void mark_pending(const char* name)
+{
+    if (!has_jack_extension(name)) {
+        return;
+    }
+
+    for (uint16_t i = 0; i < watchedFilesCount; i++) {
+        if (strcmp(watchedFiles[i].name, name) == 0) {
+            watchedFiles[i].pending = true;
+            return;
+        }
+    }
+
+    if (watchedFilesCount >= WATCH_MAX_FILES) {
+        LOG_ERR("Too many files to watch, ignoring %s", name);
+        return;
+    }
+
+    WatchedFile* f = &watchedFiles[watchedFilesCount++];
+    snprintf(f->name, sizeof(f->name), "%s", name);
+    f->compiled = false;
+    f->pending = true;
+}
+
+static void compile_pending(const char* dir, watch_compile_fn compile)
+{
+    char path[WATCH_PATH_MAX];
+    const char* changed[WATCH_MAX_FILES];
+    uint16_t changedCount = 0;
+    struct stat st;
+    struct timespec start;
+
+    for (uint16_t i = 0; i < watchedFilesCount; i++) {
+        WatchedFile* f = &watchedFiles[i];
+        if (!f->pending) {
+            continue;
+        }
+        f->pending = false;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, f->name);
+        if (stat(path, &st) < 0) {
+            continue;
+        }
+
+        // Editors often produce several events for one save
+        if (f->compiled && f->size == st.st_size
+                && f->mtime.tv_sec == st.st_mtim.tv_sec
+                && f->mtime.tv_nsec == st.st_mtim.tv_nsec)
+        {
+            continue;
+        }
+        f->mtime = st.st_mtim;
+        f->size = st.st_size;
+        f->compiled = true;
+        changed[changedCount++] = f->name;
+    }
+
+    if (changedCount > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int ret = compile(dir, changed, changedCount);
+        printf("[watch] %u changed: %s (%.2f ms)\n", changedCount,
+               ret < 0 ? "failed" : "ok", elapsed_ms(&start));
+    }
+
+    fflush(stdout);
+}
+
+static int scan_directory(const char* dir)
+{
+    DIR* d = opendir(dir);
+    struct dirent* entry;
+
+    if (d == NULL) {
+        LOG_ERR("No such directory %s", dir);
+        return -ENOENT;
+    }
+
+    while ((entry = readdir(d)) != NULL) {
+        mark_pending(entry->d_name);
+    }
+    closedir(d);
+
+    return 0;
+}
+
+// Reads all queued events. Returns number of bytes read, 0 when no event
+// arrived within 'timeoutMs', or a negative value on error
+static int read_events(int fd, int timeoutMs)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    int ret = poll(&pfd, 1, timeoutMs);
+    if (ret < 0) {
+        return -errno;
+    }
+    if (ret == 0) {
+        return 0;
+    }
+
+    ssize_t len = read(fd, buf, sizeof(buf));
+    if (len < 0) {
+        return -errno;
+    }
+
+    for (char* p = buf; p < buf + len; ) {
+        struct inotify_event* ev = (struct inotify_event*)p;
+        if (ev->len > 0) {
+            mark_pending(ev->name);
+        }
+        p += sizeof(struct inotify_event) + ev->len;
+    }
+
+    return (int)len;
+}
+
+/*****************************************************************************/
+/* PUBLIC FUNCTIONS */
+/*****************************************************************************/
+int watch_directory(const char* dir, watch_compile_fn compile)
+{
+    int ret;
+    int fd;
+
+    fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) {
+        ret = -errno;
+        LOG_ERR("Failed initializing inotify");
+        return ret;
+    }
+
+    if (inotify_add_watch(fd, dir, WATCH_EVENT_MASK) < 0) {
+        ret = -errno;
+        LOG_ERR("Failed watching directory %s", dir);
+        close(fd);
+        return ret;
+    }
+
+    // Compile everything once, afterwards only what changes
+    ret = scan_directory(dir);
+    if (ret < 0) {
+        close(fd);
+        return ret;
+    }
+    compile_pending(dir, compile);
+
+    while (true) {
+        // Block until something happens, then keep collecting events until
+        // the directory has been quiet for the debounce window
+        ret = read_events(fd, -1);
+        while (ret > 0) {
+            ret = read_events(fd, WATCH_DEBOUNCE_MS);
+        }
+        if (ret < 0) {
+            break;
+        }
+
+        compile_pending(dir, compile);
+    }
+
+    close(fd);
+    return ret;
+}
+
+#else
+
+int watch_directory(const char* dir, watch_compile_fn compile)
+{
+    LOG_ERR("Watch mode is only supported on Linux");
+    return -ENOSYS;
+}
+
+#endif // __linux__
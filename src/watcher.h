@@ -0,0 +1,19 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <stdint.h>
+
+// Time without further events in the watched directory before the
+// accumulated set of changed files is recompiled
+#define WATCH_DEBOUNCE_MS       5
+#define WATCH_MAX_FILES         1024
+
+// Called once per round of changes with the names of the '.jack' files in
+// 'dir' that changed since they were last compiled
+typedef int (*watch_compile_fn)(const char* dir, const char* const* names, uint16_t count);
+
+// Blocks watching directory 'dir' and calls 'compile' with every set of
+// changed '.jack' files, starting with all of them. Only returns on error.
+int watch_directory(const char* dir, watch_compile_fn compile);
+
+#endif // WATCHER_H